@@ -0,0 +1,276 @@
+#include "stompconn/stomplay.hpp"
+#include "stompconn/handler.hpp"
+#include "stompconn/header_store.hpp"
+#include "stompconn/buffer_pool.hpp"
+
+#include <new>
+#include <algorithm>
+#include <deque>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// счетчик выделений памяти
+// учитываются operator new и выделения внутри libevent
+static std::size_t alloc_count = 0;
+
+void* operator new(std::size_t size)
+{
+    ++alloc_count;
+    auto ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+static void* event_malloc(std::size_t size)
+{
+    ++alloc_count;
+    return std::malloc(size);
+}
+
+static void* event_realloc(void* ptr, std::size_t size)
+{
+    ++alloc_count;
+    return std::realloc(ptr, size);
+}
+
+using namespace stompconn;
+using namespace std::literals;
+
+namespace {
+
+// fn выполняет count операций
+template<class F>
+void run(const char* name, std::size_t count, F fn)
+{
+    // прогрев
+    fn();
+
+    // вызовов fn на один замер времени
+    const std::size_t repeat = (std::max)(std::size_t{1}, 1000 / count);
+
+    using namespace std::chrono;
+    std::size_t rounds = 0;
+    std::size_t allocs = 0;
+    nanoseconds total{};
+    do {
+        auto a = alloc_count;
+        auto t = steady_clock::now();
+        for (std::size_t i = 0; i < repeat; ++i)
+            fn();
+        total += duration_cast<nanoseconds>(steady_clock::now() - t);
+        allocs += alloc_count - a;
+        rounds += repeat;
+    } while (total < 200ms);
+
+    auto ops = static_cast<double>(rounds * count);
+    std::printf("%-44s %10.1f ns/op %8.2f allocs/op\n", name,
+        static_cast<double>(total.count()) / ops,
+        static_cast<double>(allocs) / ops);
+}
+
+std::string make_messages(std::size_t count, std::size_t body_size)
+{
+    std::string rc;
+    std::string body(body_size, 'x');
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        rc += "MESSAGE\nsubscription:1\ndestination:/queue/bench"
+              "\nmessage-id:T_1@@session-"s + std::to_string(i) +
+              "\nredelivered:false\ncontent-type:application/json"
+              "\ncontent-length:"s + std::to_string(body.size()) +
+              "\n\n"s + body;
+        rc += '\0';
+        rc += '\n';
+    }
+    return rc;
+}
+
+void bench_parse(std::size_t body_size)
+{
+    constexpr std::size_t count = 1000;
+    auto data = make_messages(count, body_size);
+
+    stomplay stomp;
+    subscribe frame("/queue/bench"sv, [](packet) {});
+    stomp.add_subscribe(frame, [](packet) {});
+
+    auto name = "stomplay::parse body="s + std::to_string(body_size);
+    run(name.c_str(), count, [&] {
+        stomp.parse(data.data(), data.size());
+    });
+
+    name = "stomplay::parse(input) body="s + std::to_string(body_size);
+    run(name.c_str(), count, [&] {
+        buffer input;
+        // данные добавляются ссылкой, копирования нет
+        input.append_ref(data.data(), data.size());
+        while (!input.empty())
+        {
+            auto needle = input.contiguous_space();
+            auto ptr = reinterpret_cast<const char*>(
+                input.pullup(static_cast<ev_ssize_t>(needle)));
+            stomp.parse(input, ptr, needle);
+        }
+    });
+}
+
+void bench_header_store()
+{
+    header_store store;
+    run("header_store::set known x4", 4, [&] {
+        store.clear();
+        store.set(st_header_destination, "destination"sv, "/queue/bench"sv);
+        store.set(st_header_subscription, "subscription"sv, "1"sv);
+        store.set(st_header_message_id, "message-id"sv, "T_1@@session-1"sv);
+        store.set(st_header_content_length, "content-length"sv, "256"sv);
+    });
+
+    run("header_store::set unknown x4", 4, [&] {
+        store.clear();
+        store.set("x-custom-a"sv, "a"sv);
+        store.set("x-custom-b"sv, "b"sv);
+        store.set("x-custom-c"sv, "c"sv);
+        store.set("x-custom-d"sv, "d"sv);
+    });
+
+    store.clear();
+    store.set(st_header_subscription, "subscription"sv, "1"sv);
+    volatile std::size_t n = 0;
+    run("header_store::get known", 1, [&] {
+        n = n + store.get(st_header_subscription).size();
+    });
+}
+
+// пакет в обработчик передается по значению
+// его буфер при перемещении берется из пула
+// выделения остаются только на стороне диспетчеризации
+struct pool_scope
+{
+    pool_scope()
+    {
+        buffer_pool::reserve(16);
+    }
+
+    ~pool_scope()
+    {
+        buffer_pool::reserve(0);
+    }
+};
+
+void bench_receipt(std::size_t depth)
+{
+    pool_scope pool;
+    receipt_handler handler;
+    header_store store;
+    std::deque<receipt_handler::hex_text_type> ids;
+    for (std::size_t i = 0; i < depth; ++i)
+        ids.push_back(handler.create([](packet) {}));
+
+    auto name = "receipt_handler create+call depth="s + std::to_string(depth);
+    run(name.c_str(), 1, [&] {
+        ids.push_back(handler.create([](packet) {}));
+        handler.call(ids.front(), packet(store, {}, st_method_receipt, buffer()));
+        ids.pop_front();
+    });
+}
+
+// квитанция без ответа не должна раздувать таблицу
+void bench_receipt_straggler()
+{
+    pool_scope pool;
+    receipt_handler handler;
+    header_store store;
+    handler.create([](packet) {});
+
+    run("receipt_handler create+call straggler=1", 1, [&] {
+        auto id = handler.create([](packet) {});
+        handler.call(id, packet(store, {}, st_method_receipt, buffer()));
+    });
+}
+
+void bench_subscription(std::size_t count)
+{
+    pool_scope pool;
+    subscription_handler handler;
+    header_store store;
+    std::vector<subscription_handler::id_type> ids;
+    for (std::size_t i = 0; i < count; ++i)
+        ids.push_back(handler.create([](packet) {}));
+
+    std::string_view id = ids[count / 2];
+    auto name = "subscription_handler::call subs="s + std::to_string(count);
+    run(name.c_str(), 1, [&] {
+        handler.call(id, packet(store, {}, st_method_message, buffer()));
+    });
+
+    handler.create_subscription("/temp-queue/bench", [](packet) {});
+    run("subscription_handler::call temp-queue", 1, [&] {
+        handler.call("/temp-queue/bench"sv,
+            packet(store, {}, st_method_message, buffer()));
+    });
+}
+
+void bench_frame()
+{
+    run("frame ack complete", 1, [&] {
+        stompconn::ack frame("T_1@@session-1"sv);
+        frame.data();
+    });
+
+    std::string body(256, 'x');
+    run("body_frame send complete body=256", 1, [&] {
+        stompconn::send frame("/queue/bench"sv);
+        frame.push(header::content_type_json());
+        frame.push(header::timestamp(std::size_t{1600000000000}));
+        frame.push_payload(body.data(), body.size());
+        frame.data();
+    });
+
+    run("push_encoded clean 64", 1, [&] {
+        frame frame;
+        frame.push(header::make("x-key"sv,
+            "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef"sv));
+    });
+
+    run("push_encoded escaped 64", 1, [&] {
+        frame frame;
+        frame.push(header::make("x-key"sv,
+            "0123456789:bcdef0123456789\\bcdef0123456789\nbcdef0123456789\rbcdef"sv));
+    });
+}
+
+} // namespace
+
+int main()
+{
+#ifndef EVENT__DISABLE_MM_REPLACEMENT
+    event_set_mem_functions(event_malloc, event_realloc, std::free);
+#endif
+
+    bench_parse(64);
+    bench_parse(4096);
+    bench_parse(65536);
+    bench_header_store();
+    bench_receipt(1);
+    bench_receipt(1000);
+    bench_receipt(100000);
+    bench_receipt_straggler();
+    bench_subscription(10);
+    bench_subscription(1000);
+    bench_frame();
+    return 0;
+}
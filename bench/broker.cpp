@@ -0,0 +1,315 @@
+#include "broker.hpp"
+#include "stomptalk/parser.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+using namespace stompconn;
+using namespace stompconn::bench;
+using namespace std::literals;
+
+session::session(broker& broker, event_base* queue,
+    evutil_socket_t fd, std::string id)
+    : broker_(broker)
+    , id_(std::move(id))
+{
+    bev_.create(queue, fd);
+    bev_.set(&session::recvcb, nullptr, &session::evcb, this);
+    bev_.enable(EV_READ);
+}
+
+void session::recvcb(bufferevent*, void* self) noexcept
+{
+    assert(self);
+    static_cast<session*>(self)->do_recv();
+}
+
+void session::evcb(bufferevent*, short what, void* self) noexcept
+{
+    assert(self);
+    auto s = static_cast<session*>(self);
+    if (what & (BEV_EVENT_EOF|BEV_EVENT_ERROR))
+        s->broker_.remove(s);
+}
+
+void session::do_recv() noexcept
+{
+    auto input = bev_.input();
+    try
+    {
+        while (!input.empty())
+        {
+            auto needle = input.contiguous_space();
+            auto ptr = reinterpret_cast<const char*>(
+                input.pullup(static_cast<ev_ssize_t>(needle)));
+
+            auto rc = stomp_.run(hook_, ptr, needle);
+            if (rc < needle)
+            {
+                std::cerr << "broker parse: "
+                          << stomptalk_get_error_str(hook_.error()) << std::endl;
+                broker_.remove(this);
+                return;
+            }
+
+            input.drain(rc);
+        }
+        return;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "broker recv: " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cerr << "broker recv" << std::endl;
+    }
+
+    broker_.remove(this);
+}
+
+void session::on_frame(stomptalk::parser_hook&, const char*) noexcept
+{
+    method_ = st_method_none;
+    header_ = st_header_none;
+    header_store_.clear();
+    body_.drain(body_.size());
+}
+
+void session::on_method(stomptalk::parser_hook&,
+    std::uint64_t method_id, const char*, std::size_t) noexcept
+{
+    method_ = method_id;
+}
+
+void session::on_hdr_key(stomptalk::parser_hook& hook,
+    std::uint64_t header_id, const char* ptr, std::size_t size) noexcept
+{
+    try
+    {
+        header_ = header_id;
+        current_header_.assign(ptr, size);
+        return;
+    }
+    catch (...)
+    {   }
+
+    hook.set(stomptalk_error_generic);
+}
+
+void session::on_hdr_val(stomptalk::parser_hook& hook,
+    const char* ptr, std::size_t size) noexcept
+{
+    try
+    {
+        header_store_.set(header_, current_header_,
+            std::string_view{ptr, size});
+        return;
+    }
+    catch (...)
+    {   }
+
+    hook.set(stomptalk_error_generic);
+}
+
+void session::on_body(stomptalk::parser_hook& hook,
+    const void* data, std::size_t size) noexcept
+{
+    try
+    {
+        body_.append(data, size);
+        return;
+    }
+    catch (...)
+    {   }
+
+    hook.set(stomptalk_error_generic);
+}
+
+void session::on_frame_end(stomptalk::parser_hook& hook, const char*) noexcept
+{
+    try
+    {
+        broker_.count_frame();
+        exec_frame();
+        return;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "broker frame: " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cerr << "broker frame" << std::endl;
+    }
+
+    hook.set(stomptalk_error_generic);
+}
+
+void session::exec_frame()
+{
+    switch (method_)
+    {
+    case st_method_connect:
+    case st_method_stomp: {
+        connected frame(id_, "stompconn-bench"sv);
+        frame.push(header::heart_beat(0, 0));
+        write(frame);
+        break;
+    }
+
+    case st_method_subscribe: {
+        auto id = header_store_.get(st_header_id);
+        auto destination = header_store_.get(st_header_destination);
+        if (id.empty() || destination.empty())
+        {
+            error frame("subscribe id or destination empty"sv,
+                header_store_.get(st_header_receipt));
+            write(frame);
+            break;
+        }
+        subscription_.push_back({std::string{id}, std::string{destination}});
+        send_receipt();
+        break;
+    }
+
+    case st_method_unsubscribe: {
+        auto id = header_store_.get(st_header_id);
+        for (auto i = subscription_.begin(); i != subscription_.end(); ++i)
+        {
+            if (i->id == id)
+            {
+                subscription_.erase(i);
+                break;
+            }
+        }
+        send_receipt();
+        break;
+    }
+
+    case st_method_send: {
+        auto destination = header_store_.get(st_header_destination);
+        auto size = body_.size();
+        std::string_view body;
+        if (size)
+        {
+            body = std::string_view{reinterpret_cast<const char*>(
+                body_.pullup(static_cast<ev_ssize_t>(size))), size};
+        }
+        broker_.publish(destination, body);
+        send_receipt();
+        break;
+    }
+
+    case st_method_ack:
+    case st_method_nack:
+    case st_method_begin:
+    case st_method_commit:
+    case st_method_abort:
+        send_receipt();
+        break;
+
+    case st_method_disconnect:
+        send_receipt();
+        break;
+    }
+}
+
+void session::send_receipt()
+{
+    auto id = header_store_.get(st_header_receipt);
+    if (!id.empty())
+    {
+        receipt frame(id);
+        write(frame);
+    }
+}
+
+void session::write(frame& frame)
+{
+    frame.write(bev_);
+}
+
+void session::deliver(std::string_view destination,
+    std::size_t message_id, std::string_view body)
+{
+    for (auto& s : subscription_)
+    {
+        if (s.destination == destination)
+        {
+            message frame(destination, s.id, message_id);
+            if (!body.empty())
+                frame.push_payload(body.data(), body.size());
+            write(frame);
+        }
+    }
+}
+
+broker::broker(event_base* queue) noexcept
+    : queue_(queue)
+{
+    assert(queue);
+}
+
+broker::~broker()
+{
+    if (listener_)
+        evconnlistener_free(listener_);
+}
+
+void broker::acceptcb(evconnlistener*, evutil_socket_t fd,
+    sockaddr*, int, void* self) noexcept
+{
+    assert(self);
+    auto b = static_cast<broker*>(self);
+    try
+    {
+        auto id = "session-"s + std::to_string(++b->session_seq_id_);
+        b->session_.push_back(std::make_unique<session>(*b,
+            b->queue_, fd, std::move(id)));
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "broker accept: " << e.what() << std::endl;
+    }
+}
+
+int broker::listen(const std::string& host, int port)
+{
+    sockaddr_in sin{};
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(static_cast<std::uint16_t>(port));
+    if (1 != evutil_inet_pton(AF_INET, host.c_str(), &sin.sin_addr))
+        throw std::runtime_error("broker address");
+
+    listener_ = evconnlistener_new_bind(queue_, &broker::acceptcb, this,
+        LEV_OPT_CLOSE_ON_FREE|LEV_OPT_REUSEABLE, -1,
+        reinterpret_cast<sockaddr*>(&sin), sizeof(sin));
+    if (!listener_)
+        throw std::runtime_error("evconnlistener_new_bind");
+
+    ev_socklen_t len = sizeof(sin);
+    auto fd = evconnlistener_get_fd(listener_);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&sin), &len) != 0)
+        throw std::runtime_error("getsockname");
+
+    return ntohs(sin.sin_port);
+}
+
+void broker::remove(session* ptr) noexcept
+{
+    session_.remove_if([&](auto& s) {
+        return s.get() == ptr;
+    });
+}
+
+void broker::publish(std::string_view destination, std::string_view body)
+{
+    auto message_id = ++message_seq_id_;
+    for (auto& s : session_)
+        s->deliver(destination, message_id, body);
+}
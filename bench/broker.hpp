@@ -0,0 +1,126 @@
+#pragma once
+
+#include "stompconn/frame.hpp"
+#include "stompconn/header_store.hpp"
+#include "stomptalk/parser.hpp"
+#include "stomptalk/hook_base.hpp"
+
+#include "event2/listener.h"
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace stompconn {
+namespace bench {
+
+class broker;
+
+// сессия клиента на стороне брокера
+class session final
+    : public stomptalk::hook_base
+{
+    struct subscription
+    {
+        std::string id{};
+        std::string destination{};
+    };
+
+    broker& broker_;
+    bev bev_{};
+    std::string id_{};
+
+    stomptalk::parser stomp_{};
+    stomptalk::parser_hook hook_{*this};
+    header_store header_store_{};
+    std::uint64_t method_{};
+    std::uint64_t header_{};
+    std::string current_header_{};
+    buffer body_{};
+
+    std::vector<subscription> subscription_{};
+
+    static void recvcb(bufferevent*, void* self) noexcept;
+
+    static void evcb(bufferevent*, short what, void* self) noexcept;
+
+    void do_recv() noexcept;
+
+    virtual void on_frame(stomptalk::parser_hook&,
+                          const char*) noexcept override;
+
+    virtual void on_method(stomptalk::parser_hook& hook,
+        std::uint64_t method_id, const char* ptr, std::size_t size) noexcept override;
+
+    virtual void on_hdr_key(stomptalk::parser_hook& hook,
+        std::uint64_t header_id, const char* ptr, std::size_t size) noexcept override;
+
+    virtual void on_hdr_val(stomptalk::parser_hook& hook,
+        const char* ptr, std::size_t size) noexcept override;
+
+    virtual void on_body(stomptalk::parser_hook& hook,
+        const void* data, std::size_t size) noexcept override;
+
+    virtual void on_frame_end(stomptalk::parser_hook&,
+                              const char*) noexcept override;
+
+    void exec_frame();
+
+    void send_receipt();
+
+public:
+    session(broker& broker, event_base* queue,
+        evutil_socket_t fd, std::string id);
+
+    void write(frame& frame);
+
+    // доставить сообщение подписчикам сессии
+    void deliver(std::string_view destination,
+        std::size_t message_id, std::string_view body);
+};
+
+// брокер для нагрузочных тестов
+// принимает CONNECT SUBSCRIBE UNSUBSCRIBE SEND ACK NACK DISCONNECT
+// сообщения доставляются всем подписчикам назначения
+class broker
+{
+    event_base* queue_{};
+    evconnlistener* listener_{};
+    std::list<std::unique_ptr<session>> session_{};
+    std::size_t session_seq_id_{};
+    std::size_t message_seq_id_{};
+    std::size_t frames_{};
+
+    static void acceptcb(evconnlistener*, evutil_socket_t fd,
+        sockaddr*, int, void* self) noexcept;
+
+public:
+    explicit broker(event_base* queue) noexcept;
+
+    ~broker();
+
+    broker(const broker&) = delete;
+    broker& operator=(const broker&) = delete;
+
+    // port = 0 выбрать свободный порт
+    // возвращает порт
+    int listen(const std::string& host, int port);
+
+    void remove(session* ptr) noexcept;
+
+    void publish(std::string_view destination, std::string_view body);
+
+    void count_frame() noexcept
+    {
+        ++frames_;
+    }
+
+    std::size_t frames() const noexcept
+    {
+        return frames_;
+    }
+};
+
+} // namespace bench
+} // namespace stompconn
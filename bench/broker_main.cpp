@@ -0,0 +1,35 @@
+#include "broker.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+// stompconn_broker [host] [port]
+int main(int argc, char* argv[])
+{
+    try
+    {
+        std::string host = (argc > 1) ? argv[1] : "127.0.0.1";
+        int port = (argc > 2) ? std::atoi(argv[2]) : 61613;
+
+        auto queue = event_base_new();
+        if (!queue)
+            throw std::runtime_error("event_base_new");
+
+        {
+            stompconn::bench::broker broker(queue);
+            port = broker.listen(host, port);
+            std::cout << "listen " << host << ':' << port << std::endl;
+
+            event_base_dispatch(queue);
+        }
+
+        event_base_free(queue);
+        return 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+
+    return 1;
+}
@@ -0,0 +1,388 @@
+#include "stompconn/dispatcher.hpp"
+
+#include "event2/listener.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+// проверки поведения соединения против сценарного брокера
+// код возврата 0 если все проверки прошли
+
+using namespace stompconn;
+using namespace std::literals;
+
+namespace {
+
+int failed = 0;
+
+void check(bool ok, const char* what)
+{
+    std::printf("%-48s %s\n", what, ok ? "ok" : "FAIL");
+    if (!ok)
+        ++failed;
+}
+
+// брокер с заданным сценарием, одно соединение
+// отвечает на CONNECT, SUBSCRIBE и DISCONNECT
+// после SUBSCRIBE отправляет сообщения из message
+// после DISCONNECT закрывает соединение
+class peer
+{
+public:
+    struct message_type
+    {
+        std::string id{};
+        std::string key{};
+    };
+
+    std::vector<message_type> message{};
+
+private:
+    event_base* queue_{};
+    evconnlistener* listener_{};
+    bev bev_{};
+    std::string input_{};
+    std::vector<std::string> frame_{};
+    std::size_t accepted_{};
+    bool closing_{};
+
+    static void acceptcb(evconnlistener*, evutil_socket_t fd,
+        sockaddr*, int, void* self) noexcept
+    {
+        assert(self);
+        auto p = static_cast<peer*>(self);
+        try
+        {
+            ++p->accepted_;
+            p->closing_ = false;
+            p->input_.clear();
+            p->bev_.destroy();
+            p->bev_.create(p->queue_, fd);
+            p->bev_.set(&peer::recvcb, &peer::writecb, &peer::evcb, p);
+            p->bev_.enable(EV_READ);
+        }
+        catch (...)
+        {
+            evutil_closesocket(fd);
+        }
+    }
+
+    static void recvcb(bufferevent*, void* self) noexcept
+    {
+        assert(self);
+        try
+        {
+            static_cast<peer*>(self)->do_recv();
+        }
+        catch (...)
+        {
+            static_cast<peer*>(self)->bev_.destroy();
+        }
+    }
+
+    static void writecb(bufferevent*, void* self) noexcept
+    {
+        assert(self);
+        auto p = static_cast<peer*>(self);
+        if (p->closing_)
+            p->bev_.destroy();
+    }
+
+    static void evcb(bufferevent*, short what, void* self) noexcept
+    {
+        assert(self);
+        if (what & (BEV_EVENT_EOF|BEV_EVENT_ERROR))
+            static_cast<peer*>(self)->bev_.destroy();
+    }
+
+    static std::string get(const std::string& frame, std::string_view key)
+    {
+        auto needle = "\n"s + std::string(key) + ":";
+        auto pos = frame.find(needle);
+        if (pos == std::string::npos)
+            return std::string();
+        pos += needle.size();
+        return frame.substr(pos, frame.find('\n', pos) - pos);
+    }
+
+    void send(std::string text)
+    {
+        text.push_back('\0');
+        bev_.write(text.data(), text.size());
+    }
+
+    void send_receipt(const std::string& frame)
+    {
+        auto id = get(frame, "receipt"sv);
+        if (!id.empty())
+            send("RECEIPT\nreceipt-id:" + id + "\n\n");
+    }
+
+    void do_recv()
+    {
+        auto input = bev_.input();
+        auto size = input.size();
+        auto ptr = reinterpret_cast<const char*>(
+            input.pullup(static_cast<ev_ssize_t>(size)));
+        input_.append(ptr, size);
+        input.drain(size);
+
+        std::size_t pos;
+        while ((pos = input_.find('\0')) != std::string::npos)
+        {
+            auto frame = input_.substr(0, pos);
+            input_.erase(0, pos + 1);
+            frame.erase(0, frame.find_first_not_of('\n'));
+            if (frame.empty())
+                continue;
+
+            auto method = frame.substr(0, frame.find('\n'));
+            frame_.push_back(method);
+
+            if ((method == "CONNECT") || (method == "STOMP"))
+                send("CONNECTED\nversion:1.2\n\n");
+            else if (method == "SUBSCRIBE")
+            {
+                send_receipt(frame);
+                auto subscription = get(frame, "id"sv);
+                for (auto& m : message)
+                {
+                    send("MESSAGE\nsubscription:" + subscription +
+                        "\nmessage-id:" + m.id + "\nid:" + m.id +
+                        "\nx-key:" + m.key + "\n\n");
+                }
+            }
+            else if (method == "DISCONNECT")
+            {
+                send_receipt(frame);
+                closing_ = true;
+            }
+            else
+                send_receipt(frame);
+        }
+    }
+
+public:
+    explicit peer(event_base* queue)
+        : queue_(queue)
+    {
+        assert(queue);
+    }
+
+    ~peer()
+    {
+        bev_.destroy();
+        if (listener_)
+            evconnlistener_free(listener_);
+    }
+
+    peer(const peer&) = delete;
+    peer& operator=(const peer&) = delete;
+
+    int listen()
+    {
+        sockaddr_in sin{};
+        sin.sin_family = AF_INET;
+        sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listener_ = evconnlistener_new_bind(queue_, &peer::acceptcb, this,
+            LEV_OPT_CLOSE_ON_FREE|LEV_OPT_REUSEABLE, -1,
+            reinterpret_cast<sockaddr*>(&sin), sizeof(sin));
+        if (!listener_)
+            throw std::runtime_error("evconnlistener_new_bind");
+
+        ev_socklen_t len = sizeof(sin);
+        auto fd = evconnlistener_get_fd(listener_);
+        if (getsockname(fd, reinterpret_cast<sockaddr*>(&sin), &len) != 0)
+            throw std::runtime_error("getsockname");
+
+        return ntohs(sin.sin_port);
+    }
+
+    // сколько кадров method получено
+    std::size_t count(std::string_view method) const noexcept
+    {
+        std::size_t rc = 0;
+        for (auto& f : frame_)
+            rc += (f == method);
+        return rc;
+    }
+
+    std::size_t accepted() const noexcept
+    {
+        return accepted_;
+    }
+};
+
+// периодическая проверка условия в потоке очереди
+struct poll_type
+{
+    event_base* queue{};
+    std::function<bool()> fn{};
+    std::chrono::steady_clock::time_point deadline{};
+
+    void run() noexcept
+    {
+        try
+        {
+            if (fn() || (std::chrono::steady_clock::now() > deadline))
+                event_base_loopexit(queue, nullptr);
+        }
+        catch (...)
+        {
+            event_base_loopexit(queue, nullptr);
+        }
+    }
+};
+
+// выполнять очередь пока fn не вернет true или до таймаута
+bool run_until(event_base* queue, std::function<bool()> fn,
+    std::chrono::milliseconds timeout = 5s)
+{
+    poll_type poll{ queue, fn, std::chrono::steady_clock::now() + timeout };
+    ev_timeout_fn<poll_type> poll_fn{ poll, &poll_type::run };
+    ev timer;
+    timer.create_interval(queue, poll_fn);
+    timer.add(5ms);
+    event_base_dispatch(queue);
+    return fn();
+}
+
+// ключи попадающие в разные потоки обработки
+std::pair<std::string, std::string> split_keys(std::size_t workers)
+{
+    fnv1a h;
+    std::string a = "a";
+    auto wa = h(a.data(), a.size()) % workers;
+    for (char c = 'b'; c <= 'z'; ++c)
+    {
+        std::string b(1, c);
+        if ((h(b.data(), b.size()) % workers) != wa)
+            return { a, b };
+    }
+    throw std::runtime_error("split_keys");
+}
+
+// остановка dispatcher не подтверждает кадры
+// первый кадр еще в обработке, второй обработан и ждет за ним
+// накопительный ACK второго при ack:client подтвердил бы и первый
+void check_dispatcher_stop()
+{
+    auto queue = event_base_new();
+    auto keys = split_keys(2);
+
+    {
+        peer server(queue);
+        server.message = { { "1", keys.first }, { "2", keys.second } };
+        auto port = server.listen();
+
+        std::atomic<bool> second_done{};
+        std::unique_ptr<dispatcher> d;
+        bool subscribed = false;
+
+        connection* conn_ptr = nullptr;
+        connection conn(queue, [](short) {}, [&] {
+            conn_ptr->send(logon("/"sv, "guest"sv, "guest"sv), [&](packet) {
+                subscribe s("/queue/check"sv, d->handler("x-key"sv,
+                    [&](owned_packet& p) {
+                        if (p.get("x-key"sv) == keys.first)
+                            std::this_thread::sleep_for(300ms);
+                        else
+                            second_done = true;
+                        return dispatcher::result::ack;
+                    }));
+                s.push(header::ack_client());
+                conn_ptr->send(std::move(s), [&](packet) {
+                    subscribed = true;
+                });
+            });
+        });
+        conn_ptr = &conn;
+        d = std::make_unique<dispatcher>(conn, 2, 16);
+        conn.connect("127.0.0.1", port);
+
+        // второй кадр завершен и учтен в потоке очереди
+        auto ready = run_until(queue, [&] {
+            return subscribed && second_done && (d->inflight() == 1);
+        });
+        check(ready, "dispatcher: second frame done first");
+
+        d->stop();
+        check(d->inflight() == 0, "dispatcher: stop releases frames");
+
+        run_until(queue, [] { return false; }, 100ms);
+        check(server.count("ACK"sv) == 0, "dispatcher: stop sends no ACK");
+
+        d.reset();
+        conn.disconnect();
+    }
+
+    event_base_free(queue);
+}
+
+// после logout закрытие соединения брокером
+// не должно запускать переподключение
+void check_logout_no_reconnect()
+{
+    auto queue = event_base_new();
+
+    {
+        peer server(queue);
+        auto port = server.listen();
+
+        bool logged_out = false;
+        bool event = false;
+
+        connection* conn_ptr = nullptr;
+        connection conn(queue, [&](short) {
+            event = true;
+        }, [&] {
+            conn_ptr->send(logon("/"sv, "guest"sv, "guest"sv), [&](packet) {
+                conn_ptr->logout([&](packet) {
+                    logged_out = true;
+                });
+            });
+        });
+        conn_ptr = &conn;
+
+        reconnect_policy policy;
+        policy.min_delay = 10ms;
+        conn.reconnect(policy);
+        conn.connect("127.0.0.1", port);
+
+        auto closed = run_until(queue, [&] {
+            return logged_out && event;
+        });
+        check(closed, "logout: close reported through event");
+
+        // время на несколько попыток переподключения
+        run_until(queue, [] { return false; }, 200ms);
+        check(!conn.reconnecting(), "logout: not reconnecting");
+        check(server.accepted() == 1, "logout: no new connection");
+        check(server.count("CONNECT"sv) == 1, "logout: no new logon");
+
+        conn.disconnect();
+    }
+
+    event_base_free(queue);
+}
+
+} // namespace
+
+int main()
+{
+    check_dispatcher_stop();
+    check_logout_no_reconnect();
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
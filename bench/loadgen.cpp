@@ -0,0 +1,330 @@
+#include "broker.hpp"
+#include "stompconn/publisher.hpp"
+#include "stompconn/buffer_pool.hpp"
+
+#include <ctime>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace stompconn;
+using namespace std::literals;
+
+namespace {
+
+struct options
+{
+    std::size_t count{100000};
+    std::size_t window{1000};
+    std::size_t body_size{256};
+    std::size_t batch{0};
+    std::size_t pool{0};
+    bool consume{true};
+    bool stamp{false};
+    std::string host{};
+    int port{61613};
+};
+
+void usage()
+{
+    std::cout << "stompconn_loadgen [-n count] [-w window] [-s body_size]\n"
+                 "    [-b batch_frames] [-P buffer_pool] [-t frame_template]\n"
+                 "    [-x no consume] [-h host] [-p port]\n"
+                 "without -h the broker runs in process on 127.0.0.1\n";
+}
+
+bool parse(options& opt, int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "-x"sv)
+        {
+            opt.consume = false;
+            continue;
+        }
+
+        if (arg == "-t"sv)
+        {
+            opt.stamp = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        auto val = argv[++i];
+        if (arg == "-n"sv)
+            opt.count = std::strtoull(val, nullptr, 10);
+        else if (arg == "-w"sv)
+            opt.window = std::strtoull(val, nullptr, 10);
+        else if (arg == "-s"sv)
+            opt.body_size = std::strtoull(val, nullptr, 10);
+        else if (arg == "-b"sv)
+            opt.batch = std::strtoull(val, nullptr, 10);
+        else if (arg == "-P"sv)
+            opt.pool = std::strtoull(val, nullptr, 10);
+        else if (arg == "-h"sv)
+            opt.host = val;
+        else if (arg == "-p"sv)
+            opt.port = std::atoi(val);
+        else
+            return false;
+    }
+
+    return opt.count && opt.window;
+}
+
+// процессорное время процесса
+double cpu_time() noexcept
+{
+#ifndef _WIN32
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return static_cast<double>(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) +
+        static_cast<double>(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+class loadgen
+{
+    using clock = std::chrono::steady_clock;
+
+    event_base* queue_{};
+    options opt_{};
+    connection conn_;
+    publisher publisher_;
+    std::string body_{};
+    frame_template tmpl_{"/queue/bench"sv};
+
+    std::size_t sent_{};
+    std::size_t confirmed_{};
+    std::size_t received_{};
+    std::vector<clock::time_point> start_{};
+    std::vector<std::uint64_t> latency_{};
+
+    clock::time_point begin_{};
+    double cpu_begin_{};
+    bool error_{};
+
+    void on_event(short) noexcept
+    {
+        std::cerr << "disconnected" << std::endl;
+        publisher_.clear();
+        error_ = true;
+        event_base_loopexit(queue_, nullptr);
+    }
+
+    void on_connect()
+    {
+        conn_.send(logon("/"sv, "guest"sv, "guest"sv), [this](packet p) {
+            if (!p)
+            {
+                std::cerr << "logon: " << p.dump() << std::endl;
+                return fail();
+            }
+
+            if (!opt_.consume)
+                return start();
+
+            conn_.send(subscribe("/queue/bench"sv, [this](packet) {
+                ++received_;
+            }), [this](packet p) {
+                if (!p)
+                {
+                    std::cerr << "subscribe: " << p.dump() << std::endl;
+                    return fail();
+                }
+                start();
+            });
+        });
+    }
+
+    void fail()
+    {
+        error_ = true;
+        event_base_loopexit(queue_, nullptr);
+    }
+
+    void start()
+    {
+        if (opt_.batch)
+            conn_.batch(opt_.batch);
+
+        begin_ = clock::now();
+        cpu_begin_ = cpu_time();
+        publish();
+    }
+
+    void publish()
+    {
+        // окно квитанций держит publisher
+        // при отказе продолжим в on_writable
+        while (sent_ < opt_.count)
+        {
+            auto num = sent_;
+            auto frame = opt_.stamp ?
+                tmpl_.stamp() : stompconn::send("/queue/bench"sv);
+            if (!body_.empty())
+                frame.push_payload(body_.data(), body_.size());
+
+            start_[num] = clock::now();
+            auto rc = publisher_.send(std::move(frame), [this, num](packet p) {
+                confirm(num, std::move(p));
+            });
+
+            if (!rc)
+                break;
+
+            ++sent_;
+        }
+    }
+
+    void confirm(std::size_t num, packet p)
+    {
+        using namespace std::chrono;
+        if (!p)
+        {
+            std::cerr << "send: " << p.dump() << std::endl;
+            return fail();
+        }
+
+        latency_[num] = static_cast<std::uint64_t>(
+            duration_cast<nanoseconds>(clock::now() - start_[num]).count());
+
+        if (++confirmed_ == opt_.count)
+            finish();
+    }
+
+    void finish()
+    {
+        using namespace std::chrono;
+        auto elapsed = duration<double>(clock::now() - begin_).count();
+        auto cpu = cpu_time() - cpu_begin_;
+
+        std::sort(latency_.begin(), latency_.end());
+        auto pct = [&](double p) {
+            auto i = static_cast<std::size_t>(p * (latency_.size() - 1));
+            return static_cast<double>(latency_[i]) / 1000.0;
+        };
+
+        std::printf("messages   %zu x %zu bytes, window %zu, batch %zu%s\n",
+            opt_.count, opt_.body_size, opt_.window, opt_.batch,
+            opt_.stamp ? ", template" : "");
+        std::printf("throughput %.0f msg/s\n",
+            static_cast<double>(opt_.count) / elapsed);
+        std::printf("latency    p50 %.1f us, p99 %.1f us, p999 %.1f us\n",
+            pct(0.5), pct(0.99), pct(0.999));
+        std::printf("cpu        %.2f us/msg\n",
+            cpu * 1e6 / static_cast<double>(opt_.count));
+        std::printf("received   %zu\n", received_);
+        if (opt_.batch)
+            std::printf("batch      %.2f frames/write\n", conn_.batch_ratio());
+        if (opt_.pool)
+        {
+            auto stat = buffer_pool::stat();
+            std::printf("pool       hit %zu, miss %zu, drop %zu\n",
+                stat.hit, stat.miss, stat.drop);
+        }
+
+        event_base_loopexit(queue_, nullptr);
+    }
+
+public:
+    loadgen(event_base* queue, options opt)
+        : queue_(queue)
+        , opt_(std::move(opt))
+        , conn_(queue, [this](short ef) { on_event(ef); },
+            [this] { on_connect(); })
+        , publisher_(conn_, opt_.window)
+        , body_(opt_.body_size, 'x')
+        , start_(opt_.count)
+        , latency_(opt_.count)
+    {
+        publisher_.on_writable([this] { publish(); });
+
+        conn_.on_except([](std::exception_ptr ex) {
+            try
+            {
+                std::rethrow_exception(ex);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "connection: " << e.what() << std::endl;
+            }
+        });
+    }
+
+    void connect(const std::string& host, int port)
+    {
+        conn_.connect(host, port);
+    }
+
+    bool error() const noexcept
+    {
+        return error_;
+    }
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        options opt;
+        if (!parse(opt, argc, argv))
+        {
+            usage();
+            return 1;
+        }
+
+        // брокер и клиент в одном потоке
+        // пул общий для обоих
+        if (opt.pool)
+            buffer_pool::reserve(opt.pool);
+
+        auto queue = event_base_new();
+        if (!queue)
+            throw std::runtime_error("event_base_new");
+
+        bool error = false;
+        {
+            // брокер в том же цикле событий
+            // его время входит в cpu/msg
+            std::unique_ptr<stompconn::bench::broker> broker;
+            auto host = opt.host;
+            auto port = opt.port;
+            if (host.empty())
+            {
+                broker = std::make_unique<stompconn::bench::broker>(queue);
+                host = "127.0.0.1";
+                port = broker->listen(host, 0);
+            }
+
+            loadgen gen(queue, opt);
+            gen.connect(host, port);
+
+            event_base_dispatch(queue);
+            error = gen.error();
+        }
+
+        event_base_free(queue);
+        return error ? 1 : 0;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+
+    return 1;
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+namespace stompconn {
+
+// накопительное подтверждение для подписок с ack:client
+// в STOMP ACK такой подписки подтверждает и все предыдущие сообщения
+// поэтому достаточно одного ACK на последнее полученное сообщение
+class ack_aggregator
+{
+public:
+    using clock = std::chrono::steady_clock;
+    using time_point = clock::time_point;
+    using duration = clock::duration;
+
+    struct stat_type
+    {
+        // получено сообщений
+        std::size_t messages{};
+        // отправлено ACK
+        std::size_t acks{};
+    };
+
+private:
+    struct state_type
+    {
+        std::size_t max_count{};
+        duration max_delay{};
+        std::string ack_id{};
+        std::size_t pending{};
+        time_point first{};
+        stat_type stat{};
+    };
+
+    using storage_type = std::map<std::string, state_type, std::less<>>;
+
+    storage_type state_{};
+
+    template<class F>
+    static void flush(state_type& state, F& fn)
+    {
+        if (state.pending)
+        {
+            state.pending = 0;
+            ++state.stat.acks;
+            fn(std::string_view{state.ack_id});
+        }
+    }
+
+public:
+    ack_aggregator() = default;
+
+    // ACK отправляется каждые max_count сообщений
+    // но не позже чем через max_delay после первого неподтвержденного
+    void setup(std::string_view subscription_id,
+        std::size_t max_count, duration max_delay);
+
+    bool contains(std::string_view subscription_id) const noexcept
+    {
+        return state_.find(subscription_id) != state_.end();
+    }
+
+    // запомнить полученное сообщение
+    // возвращает срок сброса подписки
+    // time_point::max() если подписка не настроена
+    // now если пора отправлять ACK
+    time_point push(std::string_view subscription_id,
+        std::string_view ack_id, time_point now);
+
+    // отправить накопленное для подписки
+    template<class F>
+    void flush(std::string_view subscription_id, F fn)
+    {
+        auto f = state_.find(subscription_id);
+        if (f != state_.end())
+            flush(std::get<1>(*f), fn);
+    }
+
+    // отправить накопленное для всех подписок
+    template<class F>
+    void flush(F fn)
+    {
+        for (auto& s : state_)
+            flush(std::get<1>(s), fn);
+    }
+
+    // отправить накопленное дольше max_delay
+    // возвращает ближайший срок следующего сброса
+    template<class F>
+    time_point flush_expired(time_point now, F fn)
+    {
+        auto rc = time_point::max();
+        for (auto& s : state_)
+        {
+            auto& state = std::get<1>(s);
+            if (state.pending)
+            {
+                auto deadline = state.first + state.max_delay;
+                if (deadline <= now)
+                    flush(state, fn);
+                else
+                    rc = (std::min)(rc, deadline);
+            }
+        }
+        return rc;
+    }
+
+    void remove(std::string_view subscription_id) noexcept;
+
+    void clear() noexcept
+    {
+        state_.clear();
+    }
+
+    // сбросить накопленное без отправки, настройки подписок сохраняются
+    // сообщения неподтвержденные до обрыва брокер доставит повторно
+    void reset() noexcept
+    {
+        for (auto& s : state_)
+        {
+            auto& state = std::get<1>(s);
+            state.pending = 0;
+            state.ack_id.clear();
+        }
+    }
+
+    const stat_type* stat(std::string_view subscription_id) const noexcept;
+};
+
+} // namespace stompconn
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+#include "event2/buffer.h"
+
+namespace stompconn {
+
+// пул пустых evbuffer текущего потока
+// buffer берет хэндл из пула и при удалении возвращает его очищенным
+// по умолчанию выключен, включается reserve в каждом потоке отдельно
+// буфер отправленный в другой поток (connection::post)
+// возвращается в пул потока где он удален
+class buffer_pool
+{
+public:
+    struct stat_type
+    {
+        // выдано из пула
+        std::size_t hit{};
+        // выделено при пустом пуле
+        std::size_t miss{};
+        // удалено при полном пуле
+        std::size_t drop{};
+    };
+
+    // размер пула текущего потока, 0 - выключить
+    // лишние буферы удаляются
+    static void reserve(std::size_t capacity);
+
+    static std::size_t capacity() noexcept;
+
+    // свободных буферов в пуле
+    static std::size_t size() noexcept;
+
+    static stat_type stat() noexcept;
+
+    // взять буфер из пула, nullptr если пул пуст
+    static evbuffer* acquire() noexcept;
+
+    // вернуть буфер в пул, false если пул выключен или полон
+    static bool release(evbuffer* ptr) noexcept;
+};
+
+} // namespace stompconn
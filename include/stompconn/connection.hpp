@@ -3,6 +3,12 @@
 #include "stompconn/stomplay.hpp"
 #include "stompconn/libevent.hpp"
 #include "stompconn/basic_text.hpp"
+#include "stompconn/ack_aggregator.hpp"
+#include "stompconn/queue.hpp"
+#include "stompconn/reconnect.hpp"
+#include "stompconn/connector.hpp"
+
+#include <map>
 
 namespace stompconn {
 
@@ -20,6 +26,17 @@ private:
     ev timeout_{};
     std::size_t write_timeout_{};
     std::size_t read_timeout_{};
+    // heart-beat запрошенный в logon
+    std::size_t heart_beat_cx_{};
+    std::size_t heart_beat_cy_{};
+    // heart-beat по счетчикам байт одним таймером
+    std::size_t write_interval_{};
+    std::size_t read_interval_{};
+    std::size_t heart_beat_tick_{};
+    std::size_t last_writed_{};
+    std::size_t last_readed_{};
+    std::size_t write_idle_{};
+    std::size_t read_idle_{};
     std::size_t bytes_writed_{};
     std::size_t bytes_readed_{};
 
@@ -35,6 +52,72 @@ private:
     std::size_t message_seq_id_{};
     bool connecting_{false};
 
+    // объединение кадров в одну запись
+    buffer batch_{};
+    ev batch_ev_{};
+    std::size_t batch_max_frames_{};
+    std::size_t batch_max_bytes_{};
+    std::size_t batch_pending_{};
+    std::size_t batch_frames_{};
+    std::size_t batch_writes_{};
+
+    // накопительные ACK
+    ack_aggregator ack_aggregator_{};
+    ev ack_timer_{};
+    ack_aggregator::time_point ack_deadline_{ack_aggregator::time_point::max()};
+
+    // пороги выходного буфера
+    std::size_t write_lowmark_{};
+    std::size_t write_highmark_{};
+    bool congested_{false};
+    callback_type on_congested_fun_{};
+    callback_type on_writable_fun_{};
+
+    // управление чтением
+    std::size_t read_lowmark_{};
+    std::size_t read_highmark_{};
+    bool read_paused_{false};
+    bool read_auto_paused_{false};
+    ev read_resume_{};
+    // незавершенная обработка сообщений по подпискам
+    std::map<std::string, std::size_t, std::less<>> pending_{};
+    std::size_t pending_limit_{};
+    std::size_t pending_overloaded_{};
+
+    // отправка из других потоков
+    std::unique_ptr<bounded_queue<evbuffer*>> post_{};
+    std::size_t post_size_{};
+    ev_timeout_fn<connection> post_fn_{ *this, &connection::do_post };
+    notify post_notify_{};
+
+    // переподключение
+    struct replay_type
+    {
+        std::string headers{};
+        std::string payload{};
+        stomplay::fun_type fn{};
+    };
+
+    std::unique_ptr<backoff> reconnect_{};
+    ev reconnect_ev_{};
+    bool reconnecting_{false};
+    // отправлен DISCONNECT, закрытие соединения не восстанавливаем
+    bool closing_{false};
+    evdns_base* dns_{};
+    std::string host_{};
+    int port_{};
+    timeval connect_timeout_{};
+    // подключение к списку адресов
+    std::vector<endpoint> endpoints_{};
+    std::chrono::milliseconds stagger_{};
+    std::unique_ptr<connector> connector_{};
+    callback_type on_reconnect_fun_{};
+    // кадры для повторной отправки
+    std::string logon_{};
+    std::map<std::string, std::string, std::less<>> resubscribe_{};
+    std::map<std::size_t, replay_type> replay_{};
+    std::size_t replay_seq_id_{};
+
     template<class A>
     struct proxy
     {
@@ -44,6 +127,12 @@ private:
             static_cast<A*>(self)->do_evcb(what);
         }
 
+        static inline void writecb(bufferevent *, void *self) noexcept
+        {
+            assert(self);
+            static_cast<A*>(self)->do_writable();
+        }
+
         static inline void recvcb(bufferevent *hbev, void *self) noexcept
         {
             assert(self);
@@ -54,18 +143,90 @@ private:
         static inline void heart_beat(evutil_socket_t, short, void* self)
         {
             assert(self);
-            static_cast<A*>(self)->send_heart_beat();
+            static_cast<A*>(self)->do_heart_beat();
+        }
+
+        static inline void flush(evutil_socket_t, short, void* self)
+        {
+            assert(self);
+            static_cast<A*>(self)->do_flush();
+        }
+
+        static inline void read_resume(evutil_socket_t, short, void* self)
+        {
+            assert(self);
+            static_cast<A*>(self)->do_read_resume();
+        }
+
+        static inline void ack_timeout(evutil_socket_t, short, void* self)
+        {
+            assert(self);
+            static_cast<A*>(self)->do_ack_timeout();
+        }
+
+        static inline void reconnect(evutil_socket_t, short, void* self)
+        {
+            assert(self);
+            static_cast<A*>(self)->do_reconnect();
         }
     };
 
     void do_evcb(short what) noexcept;
 
-    void setup_write_timeout(std::size_t timeout, double tolerant = 0.9);
+    void setup_heart_beat_timer();
 
-    void setup_read_timeout(std::size_t timeout, double tolerant = 1.3);
+    void do_heart_beat() noexcept;
 
     void do_recv(buffer_ref input) noexcept;
 
+    void do_flush() noexcept;
+
+    void do_post() noexcept;
+
+    bool post_frame(frame& frame) noexcept;
+
+    void do_writable() noexcept;
+
+    void do_read_resume() noexcept;
+
+    bool reading() const noexcept
+    {
+        return !read_paused_ && !read_auto_paused_;
+    }
+
+    void update_reading();
+
+    void check_congested() noexcept;
+
+    void do_ack_timeout() noexcept;
+
+    void setup_ack_timeout(ack_aggregator::time_point deadline,
+        ack_aggregator::time_point now);
+
+    void send_ack(std::string_view ack_id);
+
+    // исключение если bufferevent нет: до connect или во время переподключения
+    void check_connected() const;
+
+    void write(frame& frame);
+
+    // закрыть соединение, состояние протокола не трогаем
+    void teardown() noexcept;
+
+    void schedule_reconnect(short what) noexcept;
+
+    void do_reconnect() noexcept;
+
+    void start_connector();
+
+    void do_connector(bev hbev, short what) noexcept;
+
+    void do_relogon();
+
+    void exec_relogon(packet p) noexcept;
+
+    void exec_replay(std::size_t seq_id, packet p) noexcept;
+
     void create();
 
 #ifdef EVENT__HAVE_OPENSSL
@@ -147,8 +308,69 @@ public:
         connect(nullptr, host, port, timeout);
     }
 
+    // подключение к первому ответившему адресу из списка
+    // попытки запускаются с интервалом stagger
+    void connect(evdns_base* dns, std::vector<endpoint> endpoints,
+        std::chrono::milliseconds stagger = std::chrono::milliseconds(250));
+
+    void connect(std::vector<endpoint> endpoints,
+        std::chrono::milliseconds stagger = std::chrono::milliseconds(250))
+    {
+        connect(nullptr, std::move(endpoints), stagger);
+    }
+
+    // timeout ограничивает каждую попытку
+    void connect(evdns_base* dns, std::vector<endpoint> endpoints,
+        std::chrono::milliseconds stagger, timeval timeout);
+
+    template<class Rep, class Period>
+    void connect(evdns_base* dns, std::vector<endpoint> endpoints,
+        std::chrono::milliseconds stagger,
+        std::chrono::duration<Rep, Period> timeout)
+    {
+        connect(dns, std::move(endpoints), stagger,
+            detail::make_timeval(timeout));
+    }
+
+    template<class Rep, class Period>
+    void connect(std::vector<endpoint> endpoints,
+        std::chrono::milliseconds stagger,
+        std::chrono::duration<Rep, Period> timeout)
+    {
+        connect(nullptr, std::move(endpoints), stagger, timeout);
+    }
+
+    // останавливает и переподключение
     void disconnect() noexcept;
 
+    // включить переподключение, вызывается до connect
+    // после обрыва соединение восстанавливается с задержкой по policy,
+    // отправляется сохраненный logon, подписки повторяются
+    // с прежними идентификаторами и обработчиками,
+    // send с квитанцией без подтверждения отправляются повторно
+    // send с квитанцией во время переподключения ждут восстановления
+    // остальные кадры во время переподключения отклоняются исключением
+    // настройки ack_cumulative сохраняются, накопленные ACK сбрасываются
+    // on_event вызывается только когда попытки исчерпаны
+    void reconnect(const reconnect_policy& policy);
+
+    // соединение восстановлено, подписки повторены
+    void on_reconnect(callback_type fn)
+    {
+        on_reconnect_fun_ = std::move(fn);
+    }
+
+    bool reconnecting() const noexcept
+    {
+        return reconnecting_;
+    }
+
+    // неподтвержденные send сохраненные для повтора
+    std::size_t replay_size() const noexcept
+    {
+        return replay_.size();
+    }
+
     // асинхронное отключение
     // допустим из собственных калбеков
     // on_event не будет вызыван
@@ -170,6 +392,11 @@ public:
         }
     }
 
+    event_base* queue() const noexcept
+    {
+        return queue_;
+    }
+
     const std::string& session() const noexcept
     {
         return stomplay_.session();
@@ -233,6 +460,7 @@ public:
     }
 
     // stomp DISCONNECT
+    // последующее закрытие соединения брокером не переподключается
     void logout(stomplay::fun_type fn);
 
     static auto get_ack_id(const packet& p) noexcept
@@ -249,6 +477,37 @@ public:
         ack(p, false, std::move(fn));
     }
 
+    // накопительный ACK для подписки с ack:client
+    // один ACK на max_count сообщений
+    // но не позже max_delay после первого неподтвержденного
+    void ack_cumulative(std::string_view subscription_id,
+        std::size_t max_count, ack_aggregator::duration max_delay);
+
+    template<class Rep, class Period>
+    void ack_cumulative(std::string_view subscription_id,
+        std::size_t max_count, std::chrono::duration<Rep, Period> max_delay)
+    {
+        ack_cumulative(subscription_id, max_count,
+            std::chrono::duration_cast<ack_aggregator::duration>(max_delay));
+    }
+
+    // подтвердить сообщение накопительно
+    // если для подписки не настроено - ACK отправляется сразу
+    void ack_cumulative(const packet& p);
+
+    // отправить накопленные ACK подписки
+    void ack_flush(std::string_view subscription_id);
+
+    // отправить все накопленные ACK
+    void ack_flush();
+
+    // nullptr если для подписки не настроено
+    const ack_aggregator::stat_type* ack_stat(
+        std::string_view subscription_id) const noexcept
+    {
+        return ack_aggregator_.stat(subscription_id);
+    }
+
     void nack(const packet& p, bool with_transaction_id, stomplay::fun_type fn);
 
     void nack(const packet& p, stomplay::fun_type fn)
@@ -323,9 +582,132 @@ public:
     template<class F>
     void send(F frame)
     {
-        setup_write_timeout(write_timeout_);
+        write(frame);
+    }
 
-        bytes_writed_ += frame.write(bev_);
+    // объединять кадры в одну запись в bufferevent
+    // запись происходит раз в итерацию цикла событий
+    // или при накоплении max_frames кадров либо max_bytes байт
+    // max_frames = 0 выключает объединение
+    // max_bytes = 0 без ограничения по размеру
+    void batch(std::size_t max_frames, std::size_t max_bytes = 0);
+
+    // записать накопленные кадры
+    void flush();
+
+    // очередь отправки из других потоков
+    // вызывается в потоке очереди до первого post
+    // size - степень двойки, сколько кадров может ожидать записи
+    void post_queue(std::size_t size);
+
+    // потокобезопасная отправка кадра без квитанции
+    // кадр сериализуется в вызывающем потоке
+    // и записывается в потоке очереди вместе с остальными
+    // false если очередь заполнена или не создана, кадр отбрасывается
+    template<class F>
+    bool post(F frame) noexcept
+    {
+        return post_frame(frame);
+    }
+
+    // сколько кадров было записано через объединение
+    std::size_t batch_frames() const noexcept
+    {
+        return batch_frames_;
+    }
+
+    // сколько было записей объединенных кадров
+    std::size_t batch_writes() const noexcept
+    {
+        return batch_writes_;
+    }
+
+    // среднее количество кадров на одну запись
+    double batch_ratio() const noexcept
+    {
+        return batch_writes_ ?
+            static_cast<double>(batch_frames_) / batch_writes_ : 0.0;
+    }
+
+    // при превышении highmark в выходном буфере вызывается on_congested
+    // после опустошения буфера до lowmark вызывается on_writable
+    // highmark = 0 выключает контроль
+    void write_watermark(std::size_t lowmark, std::size_t highmark);
+
+    void on_congested(callback_type fn)
+    {
+        on_congested_fun_ = std::move(fn);
+    }
+
+    void on_writable(callback_type fn)
+    {
+        on_writable_fun_ = std::move(fn);
+    }
+
+    bool congested() const noexcept
+    {
+        return congested_;
+    }
+
+    // байт ожидают отправки
+    std::size_t queued() const noexcept
+    {
+        auto rc = batch_.size();
+        if (bev_.handle())
+            rc += bev_.output().size();
+        return rc;
+    }
+
+    // пороги входного буфера bufferevent
+    // при достижении highmark чтение из сокета приостанавливается
+    // highmark = 0 без ограничения
+    void read_watermark(std::size_t lowmark, std::size_t highmark);
+
+    // остановить разбор входящих данных
+    // данные копятся во входном буфере до read highmark
+    // затем работает TCP backpressure
+    // контроль входящего heart-beat на время паузы отключается
+    void pause_reading();
+
+    // продолжить разбор входящих данных
+    // накопленное разбирается на следующей итерации цикла
+    void resume_reading();
+
+    bool reading_paused() const noexcept
+    {
+        return !reading();
+    }
+
+    // автоматическая пауза чтения
+    // если у подписки больше max_pending сообщений в обработке
+    // 0 выключает автоматическую паузу
+    void pending_limit(std::size_t max_pending);
+
+    std::size_t pending_limit() const noexcept
+    {
+        return pending_limit_;
+    }
+
+    // сообщение подписки взято в обработку
+    void hold(std::string_view subscription_id);
+
+    void hold(const packet& p)
+    {
+        hold(p.get_subscription());
+    }
+
+    // обработка сообщения подписки завершена
+    void release(std::string_view subscription_id);
+
+    void release(const packet& p)
+    {
+        release(p.get_subscription());
+    }
+
+    std::size_t pending(std::string_view subscription_id) const noexcept
+    {
+        auto f = pending_.find(subscription_id);
+        return (f != pending_.end()) ? std::get<1>(*f) : 0;
     }
 
     void on_error(stomplay::fun_type fn);
@@ -339,6 +721,20 @@ public:
         return connecting_;
     }
 
+    // сокет открыт, соединение могло не пройти авторизацию
+    bool connected() const noexcept
+    {
+        return bev_.handle() != nullptr;
+    }
+
+    // send с квитанцией примет кадр
+    // соединение есть или кадр дождется повтора после переподключения
+    bool can_send() const noexcept
+    {
+        return connected() ||
+            (reconnecting_ && reconnect_ && reconnect_->policy().replay);
+    }
+
     std::size_t bytes_writed() const noexcept
     {
         return bytes_writed_;
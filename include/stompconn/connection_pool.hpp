@@ -0,0 +1,200 @@
+#pragma once
+
+#include "stompconn/connection.hpp"
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace stompconn {
+
+// несколько соединений к брокеру
+// отправка распределяется по ключу (обычно destination) или по кругу
+// кадры одного ключа идут в одно соединение пока оно доступно
+// при отключении участника его ключи переходят к следующему доступному
+//
+// с общей очередью все методы вызываются в ее потоке
+// и отправка поддерживает квитанции
+// в режиме потоков каждое соединение работает в своей очереди
+// отправка через connection::post без квитанций из любого потока
+// калбеки вызываются в потоке участника
+class connection_pool
+{
+public:
+    using on_ready_type = std::function<void(std::size_t)>;
+    using on_event_type = std::function<void(std::size_t, short)>;
+
+private:
+    using queue_ptr = std::unique_ptr<event_base, decltype(&event_base_free)>;
+
+    struct member_type
+    {
+        connection_pool& pool;
+        std::size_t index{};
+        // своя очередь в режиме потоков
+        queue_ptr own_queue;
+        connection conn;
+        std::atomic<bool> ready{};
+        // неподтвержденные квитанции
+        std::size_t inflight{};
+
+        // режим потоков
+        std::thread thread{};
+        notify stop{};
+        ev_timeout_fn<member_type> stop_fn{ *this, &member_type::do_stop };
+        // повторное подключение в потоке участника
+        notify wake{};
+        ev_timeout_fn<member_type> wake_fn{ *this, &member_type::do_wake };
+
+        member_type(connection_pool& pool,
+            std::size_t index, event_base* queue);
+
+        // нет соединения и оно не устанавливается
+        bool disconnected() const noexcept;
+
+        void do_stop() noexcept;
+
+        void do_wake() noexcept;
+    };
+
+    using member_ptr = std::unique_ptr<member_type>;
+
+    // nullptr в режиме потоков
+    event_base* queue_{};
+    std::vector<member_ptr> member_{};
+    std::atomic<std::size_t> next_{};
+
+    // в режиме потоков читаются из потоков участников
+    mutable std::mutex mutex_{};
+    std::string host_{};
+    int port_{};
+    std::string vhost_{};
+    std::string login_{};
+    std::string passcode_{};
+
+    on_ready_type on_ready_fun_{};
+    on_event_type on_event_fun_{};
+
+    std::size_t confirmed_{};
+    std::size_t lost_{};
+
+    void do_connect(member_type& m) noexcept;
+
+    void connect(member_type& m);
+
+    void do_logon(member_type& m, packet p) noexcept;
+
+    void do_event(member_type& m, short what) noexcept;
+
+    void exec_receipt(member_type& m,
+        const stomplay::fun_type& fn, packet p) noexcept;
+
+    member_type* select(std::size_t start) const noexcept;
+
+    member_type* select(std::string_view key) const noexcept;
+
+    member_type* select() noexcept;
+
+    template<class F>
+    bool send(member_type* m, F frame)
+    {
+        if (!m)
+            return false;
+
+        if (!queue_)
+            return m->conn.post(std::move(frame));
+
+        m->conn.send(std::move(frame));
+        return true;
+    }
+
+    bool send(member_type* m, stompconn::send frame, stomplay::fun_type fn);
+
+public:
+    // все соединения в общей очереди
+    connection_pool(event_base* queue, std::size_t size);
+
+    // каждое соединение в своем потоке
+    // post_size - размер очереди connection::post
+    connection_pool(std::size_t size, std::size_t post_size = 1024);
+
+    ~connection_pool() noexcept;
+
+    connection_pool(const connection_pool&) = delete;
+    connection_pool& operator=(const connection_pool&) = delete;
+
+    // участник авторизован и принимает кадры
+    void on_ready(on_ready_type fn)
+    {
+        on_ready_fun_ = std::move(fn);
+    }
+
+    // участник отключен
+    void on_event(on_event_type fn)
+    {
+        on_event_fun_ = std::move(fn);
+    }
+
+    // повторный вызов подключает только отключенных участников
+    // в режиме потоков подключение выполняется в потоке участника
+    void connect(const std::string& host, int port,
+        std::string_view login, std::string_view passcode,
+        std::string_view vhost = "/");
+
+    // в режиме потоков останавливает потоки
+    void disconnect() noexcept;
+
+    // по кругу
+    bool send(stompconn::send frame)
+    {
+        return send(select(), std::move(frame));
+    }
+
+    // по ключу
+    bool send(std::string_view key, stompconn::send frame)
+    {
+        return send(select(key), std::move(frame));
+    }
+
+    // с квитанцией, только с общей очередью
+    // false если нет доступных соединений
+    bool send(stompconn::send frame, stomplay::fun_type fn)
+    {
+        return send(select(), std::move(frame), std::move(fn));
+    }
+
+    bool send(std::string_view key, stompconn::send frame,
+        stomplay::fun_type fn)
+    {
+        return send(select(key), std::move(frame), std::move(fn));
+    }
+
+    std::size_t size() const noexcept
+    {
+        return member_.size();
+    }
+
+    // сколько участников принимают кадры
+    std::size_t ready() const noexcept;
+
+    connection& at(std::size_t index)
+    {
+        return member_.at(index)->conn;
+    }
+
+    // квитанции всех участников
+    std::size_t inflight() const noexcept;
+
+    std::size_t confirmed() const noexcept
+    {
+        return confirmed_;
+    }
+
+    // квитанции потерянные при отключении
+    std::size_t lost() const noexcept
+    {
+        return lost_;
+    }
+};
+
+} // namespace stompconn
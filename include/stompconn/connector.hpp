@@ -0,0 +1,109 @@
+#pragma once
+
+#include "stompconn/libevent.hpp"
+
+#include <list>
+#include <deque>
+#include <vector>
+
+#include "event2/util.h"
+
+namespace stompconn {
+
+struct endpoint
+{
+    std::string host{};
+    int port{};
+};
+
+// параллельное подключение к списку адресов (happy eyeballs)
+// попытки запускаются по очереди с интервалом stagger
+// или сразу после неудачи предыдущей, IPv6 и IPv4 чередуются
+// каждая попытка ограничена таймаутом, неответивший адрес
+// не ждет системного таймаута SYN и уступает следующему
+// без dns и для числовых адресов перебираются все адреса точки,
+// с dns на каждое имя одна попытка через bufferevent_socket_connect_hostname
+// (evdns_getaddrinfo нет в event_core)
+// побеждает первое установленное соединение, остальные закрываются
+// результат передается в fn один раз последним действием,
+// поэтому из fn можно удалить connector
+class connector
+{
+public:
+    // bev пустой при неудаче
+    using fn_type = std::function<void(bev, short)>;
+
+private:
+    struct address_type
+    {
+        sockaddr_storage addr{};
+        // 0 - разрешить host через dns
+        ev_socklen_t len{};
+        std::string host{};
+        int port{};
+        int family{};
+    };
+
+    struct attempt_type
+    {
+        connector* self{};
+        bev handle{};
+        // таймаут попытки
+        ev timer{};
+        // событие пришло внутри connect
+        bool starting{};
+        short what{};
+    };
+
+    event_base* queue_{};
+    evdns_base* dns_{};
+    std::chrono::milliseconds stagger_{};
+    // 0 - без таймаута
+    timeval timeout_{};
+    fn_type fn_{};
+
+    std::deque<address_type> v6_{};
+    std::deque<address_type> v4_{};
+    bool prefer_v4_{};
+    std::list<attempt_type> attempt_{};
+    ev stagger_ev_{};
+    short last_error_{ BEV_EVENT_ERROR };
+
+    static void eventcb(bufferevent*, short what, void* arg);
+
+    static void staggercb(evutil_socket_t, short, void* arg);
+
+    static void timeoutcb(evutil_socket_t, short, void* arg);
+
+    std::list<attempt_type>::iterator find(attempt_type* a) noexcept;
+
+    void push(const evutil_addrinfo* res);
+
+    void exec_event(std::list<attempt_type>::iterator it, short what);
+
+    // запустить следующую попытку, false если адресов нет
+    bool start_next();
+
+    // неудача если больше нечего ждать
+    void check_failed();
+
+    void cancel() noexcept;
+
+public:
+    connector(event_base* queue, evdns_base* dns,
+        std::chrono::milliseconds stagger, fn_type fn);
+
+    // timeout - ограничение каждой попытки
+    connector(event_base* queue, evdns_base* dns,
+        std::chrono::milliseconds stagger, timeval timeout, fn_type fn);
+
+    ~connector() noexcept;
+
+    connector(const connector&) = delete;
+    connector& operator=(const connector&) = delete;
+
+    // без dns адреса разрешаются синхронно
+    void start(const std::vector<endpoint>& endpoints);
+};
+
+} // namespace stompconn
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "stompconn/connection.hpp"
+#include "stompconn/queue.hpp"
+
+#include <map>
+#include <list>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+namespace stompconn {
+
+// обработка входящих кадров пулом потоков
+// кадры с одинаковым ключом обрабатываются одним потоком по порядку
+// ключ - идентификатор подписки или значение заданного заголовка
+// ack и nack отправляются в потоке очереди соединения
+// в порядке получения кадров подписки, а не завершения обработки
+// иначе при ack:client накопительный ACK быстрого потока
+// подтвердил бы еще не обработанные кадры других потоков
+// пока кадр в обработке подписка удерживается через connection::hold
+// если у соединения не задан pending_limit, выставляется размер очереди
+// методы кроме обработчиков вызываются в потоке очереди
+class dispatcher
+{
+public:
+    enum class result
+    {
+        done,
+        ack,
+        nack
+    };
+
+    // вызывается в потоке обработки
+    using fn_type = std::function<result(owned_packet&)>;
+
+private:
+    struct item_type
+    {
+        const fn_type* fn{};
+        result rc{ result::done };
+        // номер кадра в подписке
+        std::uint64_t seq{};
+        owned_packet packet{};
+    };
+
+    using queue_type = bounded_queue<item_type>;
+
+    struct worker_type
+    {
+        queue_type queue;
+        std::mutex mutex{};
+        std::condition_variable cv{};
+        std::atomic<bool> sleeping{};
+        std::thread thread{};
+        // не поместившиеся в queue, только поток очереди
+        std::deque<item_type> backlog{};
+        // обработанные при остановке, не поместившиеся в complete_
+        // разбираются в stop после join
+        std::deque<item_type> rejected{};
+
+        explicit worker_type(std::size_t size)
+            : queue(size)
+        {   }
+    };
+
+    connection& conn_;
+    std::vector<std::unique_ptr<worker_type>> worker_{};
+    // готовые кадры от всех потоков обработки
+    queue_type complete_;
+    // обработчики живут до уничтожения dispatcher
+    std::list<fn_type> handler_{};
+    std::atomic<bool> running_{ true };
+    std::size_t inflight_{};
+
+    // результат обработки ждущий отправки
+    struct done_type
+    {
+        bool ready{};
+        result rc{ result::done };
+        std::string id{};
+    };
+
+    // кадры подписки начиная с номера base
+    struct order_type
+    {
+        std::uint64_t base{};
+        std::deque<done_type> window{};
+    };
+
+    std::map<std::string, order_type, std::less<>> order_{};
+
+    ev_timeout_fn<dispatcher> notify_fn_{ *this, &dispatcher::do_complete };
+    notify notify_{};
+
+    void post(const fn_type& fn, fnv1a::type key, packet p);
+
+    void push(worker_type& w, item_type& item);
+
+    void wakeup(worker_type& w);
+
+    // перенести отложенные кадры в очереди потоков
+    void drain_backlog();
+
+    void send_result(result rc, std::string_view id) noexcept;
+
+    void run(worker_type& w) noexcept;
+
+    void exec(worker_type& w, item_type& item) noexcept;
+
+    void do_complete() noexcept;
+
+    void complete(item_type& item) noexcept;
+
+    // отпустить кадр без ack и без учета порядка
+    void discard(item_type& item) noexcept;
+
+public:
+    // queue_size - степень двойки, размер очереди каждого потока
+    // кадры сверх очереди ждут в потоке очереди соединения
+    dispatcher(connection& conn, std::size_t workers,
+        std::size_t queue_size = 1024);
+
+    ~dispatcher() noexcept;
+
+    dispatcher(const dispatcher&) = delete;
+    dispatcher& operator=(const dispatcher&) = delete;
+
+    // обработчик для subscribe
+    // порядок сохраняется в пределах подписки
+    stomplay::fun_type handler(fn_type fn);
+
+    // порядок сохраняется в пределах значения заголовка key
+    // кадры без заголовка распределяются по идентификатору подписки
+    stomplay::fun_type handler(std::string_view key, fn_type fn);
+
+    // остановить потоки обработки
+    // после остановки ack и nack не отправляются
+    // необработанные и ждущие очереди результаты отбрасываются,
+    // брокер доставит эти кадры повторно
+    void stop() noexcept;
+
+    // кадров в обработке
+    std::size_t inflight() const noexcept
+    {
+        return inflight_;
+    }
+};
+
+} // namespace stompconn
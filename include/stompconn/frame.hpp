@@ -9,6 +9,7 @@ namespace stompconn {
 
 class packet;
 class subscription_handler;
+class frame_template;
 
 class frame
 {
@@ -38,10 +39,13 @@ public:
 
     // выставить известный хидер
     // добавляем ключ как ссылку на строку
-    template<class K, class V>
-    void push(header::known<K, V> hdr)
+    template<class K, class V, bool S>
+    void push(header::known<K, V, S> hdr)
     {
-        push_header_val(hdr.key(), hdr.value());
+        if constexpr (S)
+            push_header_safe(hdr.key(), hdr.value());
+        else
+            push_header_val(hdr.key(), hdr.value());
     }
 
     // выставить известный хидер
@@ -60,6 +64,9 @@ protected:
     // key ref, val non ref
     virtual void push_header_val(std::string_view prepared_key,
                          std::string_view value);
+    // key ref, val safe
+    virtual void push_header_safe(std::string_view prepared_key,
+                         std::string_view value);
 
     virtual void push_method(std::string_view method);
 
@@ -73,12 +80,26 @@ public:
 
     virtual buffer data();
 
+    // метод и заголовки без завершения
+    // до вызова complete
+    std::string headers() const;
+
+    // завершить кадр и забрать буфер без выделения нового
+    // кадр после вызова не используется
+    evbuffer* release();
+
     virtual std::string str() const;
+
+    // размер кадра без завершения
+    virtual std::size_t size() const noexcept;
 };
 
 class logon final
     : public frame
 {
+    std::size_t heart_beat_cx_{};
+    std::size_t heart_beat_cy_{};
+
 public:
     logon(std::string_view host, std::string_view login,
         std::string_view passcode);
@@ -86,6 +107,22 @@ public:
     logon(std::string_view host, std::string_view login);
 
     logon(std::string_view host);
+
+    // cx - интервал в мс с которым клиент может слать heart-beat
+    // cy - интервал с которым клиент хочет получать heart-beat
+    // 0 - не может или не хочет
+    // итоговые значения согласуются с ответом сервера
+    void heart_beat(std::size_t cx, std::size_t cy);
+
+    std::size_t heart_beat_cx() const noexcept
+    {
+        return heart_beat_cx_;
+    }
+
+    std::size_t heart_beat_cy() const noexcept
+    {
+        return heart_beat_cy_;
+    }
 };
 
 class subscribe final
@@ -94,14 +131,36 @@ class subscribe final
 public:
     typedef std::function<void(packet)> fn_type;
 
+    // data - очередная часть тела
+    // end - кадр завершен, часть пустая
+    // abort - тело оборвано отключением, переподключением
+    // или ошибкой разбора, часть пустая, сообщение неполное
+    enum class body_event { data, end, abort };
+    typedef std::function<void(buffer, body_event)> body_fn_type;
+
 private:
     fn_type fn_{};
+    body_fn_type body_fn_{};
 
 public:
     subscribe(std::string_view destination, fn_type fn);
 
+    // потоковый режим
+    // fn получает заголовки с пустым телом до начала тела
+    // тело приходит частями в body_fn по мере чтения из сокета
+    // каждое сообщение завершается событием end или abort
+    // для ограничения памяти используется connection::pause_reading,
+    // на время паузы контроль входящего heart-beat отключается
+    subscribe(std::string_view destination, fn_type fn, body_fn_type body_fn);
+
     // возвращает идентификатор подписки
     std::string add_subscribe(subscription_handler& handler);
+
+    // забрать обработчик тела, пустой если режим не потоковый
+    body_fn_type release_body_fn() noexcept
+    {
+        return std::move(body_fn_);
+    }
 };
 
 class body_frame
@@ -110,6 +169,20 @@ class body_frame
 protected:
     buffer payload_{};
 
+private:
+    template<class F>
+    static void proxy_release(const void*, std::size_t, void *arg) noexcept
+    {
+        auto fn = static_cast<F*>(arg);
+        try
+        {
+            (*fn)();
+        }
+        catch (...)
+        {   }
+        delete fn;
+    }
+
 public:
     body_frame() = default;
     body_frame(body_frame&&) = default;
@@ -122,9 +195,61 @@ public:
 
     void push_payload(const char *data, std::size_t size);
 
+    // тело по ссылке без копирования
+    // данные должны жить до вызова cleanupfn
+    // cleanupfn вызывается из потока цикла событий после записи в сокет
+    // или при удалении неотправленного кадра
+    void push_payload_ref(const char *data, std::size_t size,
+        evbuffer_ref_cleanup_cb cleanupfn, void *cleanupfn_arg);
+
+    // release() вызывается когда данные больше не нужны
+    template<class F>
+    void push_payload_ref(const char *data, std::size_t size, F release)
+    {
+        if (!size)
+        {
+            release();
+            return;
+        }
+
+        auto fn = new F(std::move(release));
+        try
+        {
+            push_payload_ref(data, size, &proxy_release<F>, fn);
+        }
+        catch (...)
+        {
+            delete fn;
+            throw;
+        }
+    }
+
+    // тело из участка файла
+    // данные отображаются в память (mmap) и пишутся в сокет без копирования
+    // content-length считается по длине участка
+    // при успехе fd принадлежит кадру и закрывается после записи
+    void push_file(int fd, std::size_t offset, std::size_t length);
+
+    std::string payload_str() const;
+
     virtual void complete() override;
 
     virtual std::string str() const override;
+
+    virtual std::size_t size() const noexcept override;
+};
+
+// кадр из сохраненных метода и заголовков
+// для повторной отправки после переподключения
+class replay_frame final
+    : public body_frame
+{
+public:
+    replay_frame(std::string_view headers, std::string_view payload);
+
+    explicit replay_frame(std::string_view headers)
+        : replay_frame(headers, std::string_view())
+    {   }
 };
 
 // rabbitmq temp-queue feature
@@ -201,6 +326,41 @@ class send
 {
 public:
     send(std::string_view destination);
+
+    // метод и заголовки копируются из шаблона одним куском
+    explicit send(const frame_template& tmpl);
+};
+
+// заранее собранные метод и постоянные заголовки SEND
+// экранирование выполняется один раз при добавлении заголовка
+// кадр получает их одним копированием, дальше добавляются
+// переменные заголовки, тело и content-length
+class frame_template final
+{
+    std::string prefix_{};
+
+public:
+    explicit frame_template(std::string_view destination);
+
+    // добавить постоянный заголовок
+    template<class T>
+    frame_template& push(T hdr)
+    {
+        frame f;
+        f.push(hdr);
+        prefix_ += f.headers();
+        return *this;
+    }
+
+    std::string_view prefix() const noexcept
+    {
+        return prefix_;
+    }
+
+    stompconn::send stamp() const
+    {
+        return stompconn::send(*this);
+    }
 };
 
 class error
@@ -4,31 +4,62 @@
 #include "stompconn/basic_text.hpp"
 
 #include <functional>
-#include <list>
+#include <unordered_map>
+#include <vector>
+#include <map>
 
 namespace stompconn {
 
 class receipt_handler
 {
+public:
     using hex_text_type = basic_text<char, 20>;
+
+private:
     using fn_type = std::function<void(packet)>;
-    using value_type = std::pair<hex_text_type, fn_type>;
-    using storage_type = std::list<value_type>;
-    using iterator = storage_type::iterator;
+
+    // слот индексируется номером квитанции по маске
+    struct slot_type
+    {
+        std::size_t id{};
+        fn_type fn{};
+    };
+
+    using storage_type = std::vector<slot_type>;
+    // квитанции вытесненные из кольца более новыми
+    using overflow_type = std::unordered_map<std::size_t, fn_type>;
+
+    constexpr static std::size_t initial_capacity = 64;
 
     std::size_t receipt_seq_id_{};
+    std::size_t size_{};
+    // размер кольца следует за числом ожидающих квитанций
     storage_type receipt_{};
+    overflow_type overflow_{};
+
+    void exec(fn_type& fn, packet&& p) noexcept;
 
-    void exec(iterator i, packet p) noexcept;
+    // увеличиваем таблицу вдвое
+    void grow();
 
 public:
     receipt_handler() = default;
 
-    std::string_view create(fn_type fn);
+    hex_text_type create(fn_type fn);
 
-    bool call(std::string_view id, packet p) noexcept;
+    bool call(std::string_view id, packet&& p) noexcept;
 
     void clear();
+
+    std::size_t size() const noexcept
+    {
+        return size_;
+    }
+
+    bool empty() const noexcept
+    {
+        return size_ == 0;
+    }
 };
 
 class subscription_handler
@@ -38,13 +69,31 @@ public:
     
 private:
     using fn_type = std::function<void(packet)>;
-    using storage_type = std::unordered_map<id_type, fn_type>;
+    // прозрачный поиск по string_view
+    using storage_type = std::map<id_type, fn_type, std::less<>>;
     using iterator = storage_type::iterator;
 
+    // быстрый индекс числовых идентификаторов созданных в create
+    struct slot_type
+    {
+        std::size_t id{};
+        fn_type* fn{};
+    };
+
+    using index_type = std::vector<slot_type>;
+
+    constexpr static std::size_t initial_capacity = 16;
+
     std::size_t subscription_seq_id_{};
     storage_type subscription_{};
+    index_type index_{};
+
+    void exec(fn_type& fn, packet&& p) noexcept;
+
+    // увеличиваем индекс вдвое
+    void grow();
 
-    void exec(iterator i, packet p) noexcept;
+    fn_type* find(std::string_view id) noexcept;
 
 public:
     subscription_handler() = default;
@@ -53,9 +102,9 @@ public:
 
     id_type create(fn_type fn);
 
-    bool call(const id_type& id, packet p) noexcept;
+    bool call(std::string_view id, packet&& p) noexcept;
 
-    void remove(const id_type& id) noexcept;
+    void remove(std::string_view id) noexcept;
 
     void clear();
 
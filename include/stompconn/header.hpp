@@ -73,12 +73,16 @@ constexpr static inline auto make_ref(K key, V val) noexcept
     return base_ref<K, V>(std::move(key), std::move(val));
 }
 
-template<class T, class V>
+// S - значение не требует экранирования
+// например число, добавляется без проверки
+template<class T, class V, bool S = false>
 class known 
     : base<decltype (T::header), V>
 {
     using super = base<decltype (T::header), V>;
 public:
+    constexpr static bool safe = S;
+
     constexpr explicit known(V val) noexcept
         : super{T::header, std::move(val)}
     {   }
@@ -86,6 +90,9 @@ public:
     using super::value;
 };
 
+template<class T>
+using known_num = known<T, std::string, true>;
+
 template<class T>
 class known_ref
 {
@@ -111,7 +118,7 @@ constexpr static auto content_length(std::string_view val) noexcept
 
 static inline auto content_length(std::size_t size) noexcept
 {
-    return known<tag::content_length, std::string>(std::to_string(size));
+    return known_num<tag::content_length>(std::to_string(size));
 }
 
 constexpr static auto content_type(std::string_view val) noexcept
@@ -155,7 +162,7 @@ constexpr static auto transaction(std::string_view val) noexcept
 
 static inline auto transaction(std::size_t val) noexcept
 {
-    return known<tag::transaction, std::string>(std::to_string(val));
+    return known_num<tag::transaction>(std::to_string(val));
 }
 
 //// The Stomp message id (not amqp_message_id)
@@ -166,7 +173,7 @@ constexpr static auto message_id(std::string_view val) noexcept
 
 static inline auto message_id(std::size_t val) noexcept
 {
-    return known<tag::message_id, std::string>(std::to_string(val));
+    return known_num<tag::message_id>(std::to_string(val));
 }
 
 constexpr static auto subscription(std::string_view val) noexcept
@@ -197,7 +204,7 @@ constexpr static auto heart_beat(std::string_view val) noexcept
 static inline auto heart_beat(std::size_t a, std::size_t b) noexcept
 {
     auto val = std::to_string(a) + ',' + std::to_string(b);
-    return known<tag::heart_beat, std::string>(val);
+    return known<tag::heart_beat, std::string, true>(val);
 }
 
 constexpr static auto session(std::string_view val) noexcept
@@ -243,7 +250,7 @@ constexpr static auto prefetch_count(std::string_view val) noexcept
 
 static inline auto prefetch_count(std::size_t val) noexcept
 {
-    return known<tag::prefetch_count, std::string>(std::to_string(val));
+    return known_num<tag::prefetch_count>(std::to_string(val));
 }
 //typedef basic<tag::durable> durable;
 constexpr static auto durable(std::string_view val) noexcept
@@ -264,7 +271,7 @@ constexpr static auto message_ttl(std::string_view val) noexcept
 
 static inline auto message_ttl(std::size_t val) noexcept
 {
-    return known<tag::message_ttl, std::string>(std::to_string(val));
+    return known_num<tag::message_ttl>(std::to_string(val));
 }
 
 template<class Rep, class Period>
@@ -283,7 +290,7 @@ constexpr static auto expires(std::string_view val) noexcept
 
 static inline auto expires(std::size_t val) noexcept
 {
-    return known<tag::expires, std::string>(std::to_string(val));
+    return known_num<tag::expires>(std::to_string(val));
 }
 
 template<class Rep, class Period>
@@ -302,7 +309,7 @@ constexpr static auto max_length(std::string_view val) noexcept
 
 static inline auto max_length(std::size_t val) noexcept
 {
-    return known<tag::max_length, std::string>(std::to_string(val));
+    return known_num<tag::max_length>(std::to_string(val));
 }
 
 //typedef basic<tag::max_length_bytes> max_length_bytes;
@@ -313,7 +320,7 @@ constexpr static auto max_length_bytes(std::string_view val) noexcept
 
 static inline auto max_length_bytes(std::size_t val) noexcept
 {
-    return known<tag::max_length_bytes, std::string>(std::to_string(val));
+    return known_num<tag::max_length_bytes>(std::to_string(val));
 }
 
 //typedef basic<tag::dead_letter_exchange> dead_letter_exchange;
@@ -408,7 +415,7 @@ constexpr static auto amqp_message_id(std::string_view val) noexcept
 
 static inline auto amqp_message_id(std::size_t val) noexcept
 {
-    return known<tag::amqp_message_id, std::string>(std::to_string(val));
+    return known_num<tag::amqp_message_id>(std::to_string(val));
 }
 
 //typedef basic<tag::timestamp> timestamp;
@@ -420,7 +427,7 @@ constexpr static auto timestamp(std::string_view val) noexcept
 //typedef basic<tag::timestamp> timestamp;
 static inline auto timestamp(std::uint64_t val) noexcept
 {
-    return known<tag::timestamp, std::string>(std::to_string(val));
+    return known_num<tag::timestamp>(std::to_string(val));
 }
 
 template<class Rep, class Period>
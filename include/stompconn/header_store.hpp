@@ -1,42 +1,259 @@
 #pragma once
 
 #include "stompconn/fnv1a.hpp"
+#include "stompconn/tag/header.hpp"
 
+#include <array>
 #include <string>
-#include <unordered_map>
+#include <vector>
 #include <cassert>
 
 namespace stompconn {
 
+// известные заголовки хранятся в слотах по номеру тега
+// неизвестные в небольшой таблице с открытой адресацией
+// значения копируются в общий буфер кадра
+// который переиспользуется между кадрами
 class header_store
 {
     using version_type = std::size_t;
     using hash_type = fnv1a::type;
-    using value_type = std::tuple<std::string, std::string, version_type>;
     using header_type = std::pair<std::string_view, std::string_view>;
-    using storage_type = std::unordered_map<hash_type, value_type>;
+
+    // смещение и размер в буфере кадра
+    struct range_type
+    {
+        std::size_t offset{};
+        std::size_t size{};
+    };
+
+    struct known_type
+    {
+        range_type value{};
+        version_type version{};
+    };
+
+    struct unknown_type
+    {
+        hash_type hash{};
+        range_type key{};
+        range_type value{};
+        version_type version{};
+    };
+
+    constexpr static std::size_t known_count = header::tag::count;
+    constexpr static std::size_t unknown_capacity = 16;
 
     version_type version_{1};
-    storage_type storage_{};
+    std::string text_{};
+    std::array<known_type, known_count> known_{};
+    std::vector<unknown_type> unknown_{};
+    std::size_t unknown_size_{};
+
+    // номер известного заголовка по хэшу ключа
+    constexpr static std::size_t known_num(hash_type hash) noexcept
+    {
+        using namespace header::tag;
+        switch (hash)
+        {
+        case accept_version::text_hash: return accept_version::num;
+        case ack::text_hash: return ack::num;
+        case amqp_message_id::text_hash: return amqp_message_id::num;
+        case amqp_type::text_hash: return amqp_type::num;
+        case app_id::text_hash: return app_id::num;
+        case auto_delete::text_hash: return auto_delete::num;
+        case cluster_id::text_hash: return cluster_id::num;
+        case content_encoding::text_hash: return content_encoding::num;
+        case content_length::text_hash: return content_length::num;
+        case content_type::text_hash: return content_type::num;
+        case correlation_id::text_hash: return correlation_id::num;
+        case delivery_mode::text_hash: return delivery_mode::num;
+        case destination::text_hash: return destination::num;
+        case durable::text_hash: return durable::num;
+        case expiration::text_hash: return expiration::num;
+        case expires::text_hash: return expires::num;
+        case heart_beat::text_hash: return heart_beat::num;
+        case host::text_hash: return host::num;
+        case id::text_hash: return id::num;
+        case login::text_hash: return login::num;
+        case message::text_hash: return message::num;
+        case message_id::text_hash: return message_id::num;
+        case passcode::text_hash: return passcode::num;
+        case persistent::text_hash: return persistent::num;
+        case prefetch_count::text_hash: return prefetch_count::num;
+        case priority::text_hash: return priority::num;
+        case receipt::text_hash: return receipt::num;
+        case receipt_id::text_hash: return receipt_id::num;
+        case redelivered::text_hash: return redelivered::num;
+        case reply_to::text_hash: return reply_to::num;
+        case requeue::text_hash: return requeue::num;
+        case server::text_hash: return server::num;
+        case session::text_hash: return session::num;
+        case subscription::text_hash: return subscription::num;
+        case timestamp::text_hash: return timestamp::num;
+        case transaction::text_hash: return transaction::num;
+        case user_id::text_hash: return user_id::num;
+        case version::text_hash: return version::num;
+        case dead_letter_exchange::text_hash: return dead_letter_exchange::num;
+        case dead_letter_routing_key::text_hash: return dead_letter_routing_key::num;
+        case max_length::text_hash: return max_length::num;
+        case max_length_bytes::text_hash: return max_length_bytes::num;
+        case max_priority::text_hash: return max_priority::num;
+        case message_ttl::text_hash: return message_ttl::num;
+        case original_exchange::text_hash: return original_exchange::num;
+        case original_routing_key::text_hash: return original_routing_key::num;
+        case queue_name::text_hash: return queue_name::num;
+        case queue_type::text_hash: return queue_type::num;
+        }
+        return known_count;
+    }
+
+    constexpr static std::string_view known_text(std::size_t num) noexcept
+    {
+        using namespace header::tag;
+        constexpr std::string_view text[] = {
+            accept_version::text,
+            ack::text,
+            amqp_message_id::text,
+            amqp_type::text,
+            app_id::text,
+            auto_delete::text,
+            cluster_id::text,
+            content_encoding::text,
+            content_length::text,
+            content_type::text,
+            correlation_id::text,
+            delivery_mode::text,
+            destination::text,
+            durable::text,
+            expiration::text,
+            expires::text,
+            heart_beat::text,
+            host::text,
+            id::text,
+            login::text,
+            message::text,
+            message_id::text,
+            passcode::text,
+            persistent::text,
+            prefetch_count::text,
+            priority::text,
+            receipt::text,
+            receipt_id::text,
+            redelivered::text,
+            reply_to::text,
+            requeue::text,
+            server::text,
+            session::text,
+            subscription::text,
+            timestamp::text,
+            transaction::text,
+            user_id::text,
+            version::text,
+            dead_letter_exchange::text,
+            dead_letter_routing_key::text,
+            max_length::text,
+            max_length_bytes::text,
+            max_priority::text,
+            message_ttl::text,
+            original_exchange::text,
+            original_routing_key::text,
+            queue_name::text,
+            queue_type::text,
+        };
+        static_assert(sizeof(text) / sizeof(text[0]) == known_count);
+        return text[num];
+    }
+
+    std::string_view text(range_type range) const noexcept
+    {
+        return std::string_view{text_.data() + range.offset, range.size};
+    }
+
+    range_type store(std::string_view value)
+    {
+        range_type rc{text_.size(), value.size()};
+        text_.append(value);
+        return rc;
+    }
+
+    bool alive(const unknown_type& hdr) const noexcept
+    {
+        return hdr.version == version_;
+    }
+
+    // слот с таким хэшем или первый свободный
+    std::size_t probe(const std::vector<unknown_type>& table,
+        hash_type hash) const noexcept
+    {
+        auto mask = table.size() - 1;
+        auto i = static_cast<std::size_t>(hash) & mask;
+        while (alive(table[i]) && (table[i].hash != hash))
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    void grow_unknown()
+    {
+        std::vector<unknown_type> table(unknown_.empty() ?
+            unknown_capacity : unknown_.size() * 2);
+
+        for (auto& hdr : unknown_)
+        {
+            if (alive(hdr))
+                table[probe(table, hdr.hash)] = hdr;
+        }
+
+        unknown_.swap(table);
+    }
+
+    void set_unknown(hash_type num_id, std::string_view key,
+        std::string_view value)
+    {
+        // заполняем не больше половины
+        if ((unknown_size_ + 1) * 2 > unknown_.size())
+            grow_unknown();
+
+        auto& hdr = unknown_[probe(unknown_, num_id)];
+        if (alive(hdr))
+        {
+            assert(text(hdr.key) == key);
+            hdr.value = store(value);
+        }
+        else
+        {
+            hdr.hash = num_id;
+            hdr.key = store(key);
+            hdr.value = store(value);
+            hdr.version = version_;
+            ++unknown_size_;
+        }
+    }
+
+    const unknown_type* find_unknown(hash_type num_id) const noexcept
+    {
+        if (unknown_.empty())
+            return nullptr;
+
+        auto& hdr = unknown_[probe(unknown_, num_id)];
+        return alive(hdr) ? &hdr : nullptr;
+    }
 
 public:
     header_store() = default;
 
     void set(hash_type num_id, std::string_view key, std::string_view value)
     {
-        auto f = storage_.find(num_id);
-        if (f != storage_.end())
+        auto num = known_num(num_id);
+        if (num < known_count)
         {
-            auto& t = std::get<1>(*f);           
-            assert(std::get<0>(t) == key);
-            std::get<1>(t) = value;
-            std::get<2>(t) = version_;
+            assert(known_text(num) == key);
+            auto& hdr = known_[num];
+            hdr.value = store(value);
+            hdr.version = version_;
         }
         else
-        {
-            storage_[num_id] = std::make_tuple(std::string{key}, 
-                std::string{value}, version_);
-        }
+            set_unknown(num_id, key, value);
     }
 
     void set(std::string_view key, std::string_view value)
@@ -48,26 +265,34 @@ public:
     void clear() noexcept
     {
         ++version_;
+        text_.clear();
+        unknown_size_ = 0;
     }
 
     void reset()
     {
-        storage_.clear();
+        text_.clear();
+        known_.fill(known_type());
+        unknown_.clear();
+        unknown_size_ = 0;
         version_ = 1;
     }
 
     template<class F>
     std::string_view find(hash_type num_id, F fn) const
     {
-        auto f = storage_.find(num_id);
-        if (f != storage_.end())
+        auto num = known_num(num_id);
+        if (num < known_count)
+        {
+            auto& hdr = known_[num];
+            if (hdr.version == version_)
+                return fn(std::make_pair(known_text(num), text(hdr.value)));
+        }
+        else
         {
-            const auto& t = std::get<1>(*f);
-            if (std::get<2>(t) == version_)
-            {
-                return fn(std::make_pair(std::string_view{std::get<0>(t)}, 
-                    std::string_view{std::get<1>(t)}));
-            }
+            auto hdr = find_unknown(num_id);
+            if (hdr)
+                return fn(std::make_pair(text(hdr->key), text(hdr->value)));
         }
         return {};
     }
@@ -88,24 +313,36 @@ public:
         });
     }
 
+    template<class F>
+    void for_each(F fn) const
+    {
+        for (std::size_t num = 0; num < known_count; ++num)
+        {
+            auto& hdr = known_[num];
+            if (hdr.version == version_)
+                fn(std::make_pair(known_text(num), text(hdr.value)));
+        }
+
+        for (auto& hdr : unknown_)
+        {
+            if (alive(hdr))
+                fn(std::make_pair(text(hdr.key), text(hdr.value)));
+        }
+    }
+
     std::string dump(char sep = ' ') const
     {
        std::string rc;
        rc.reserve(320);
 
-       for (auto& h : storage_)
-       {
-            const auto& t = std::get<1>(h);
-            if (std::get<2>(t) == version_)
-            {
-                if (!rc.empty())
-                    rc += sep;
-
-                rc += std::get<0>(t);
-                rc += ':';
-                rc += std::get<1>(t);
-            }
-       }
+       for_each([&](header_type hdr) {
+            if (!rc.empty())
+                rc += sep;
+
+            rc += std::get<0>(hdr);
+            rc += ':';
+            rc += std::get<1>(hdr);
+       });
 
        return rc;
     }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <chrono>
 #include <string>
@@ -164,6 +165,16 @@ public:
         assert(ptr);
     }
 
+    // забрать хэндл без выделения нового
+    // после вызова буфер пуст и пригоден только для удаления
+    evbuffer* release() noexcept
+    {
+        static_assert(std::is_same<this_type, buffer>::value);
+        auto ptr = handle_;
+        handle_ = nullptr;
+        return ptr;
+    }
+
     template<class T>
     void append(const T& str_buf)
     {
@@ -210,6 +221,16 @@ public:
         append_ref(str_ref.get());
     }
 
+    // добавить участок файла без чтения в память
+    // при успехе fd принадлежит буферу и закрывается им
+    void append_file(int fd, std::size_t offset, std::size_t len)
+    {
+        assert((fd != -1) && len);
+        detail::check_result("evbuffer_add_file",
+            evbuffer_add_file(assert_handle(), fd,
+                static_cast<ev_off_t>(offset), static_cast<ev_off_t>(len)));
+    }
+
     // Prepends data to the beginning of the evbuffer
     void prepend(const void *data, std::size_t len)
     {
@@ -274,6 +295,14 @@ public:
             evbuffer_add_buffer(other, assert_handle()));
     }
 
+    // Moves len bytes from the beginning of the evbuffer to other.
+    // whole chains are moved without copying
+    std::size_t remove_buffer(buffer& other, std::size_t len)
+    {
+        return detail::check_size("evbuffer_remove_buffer",
+            evbuffer_remove_buffer(assert_handle(), other, len));
+    }
+
     // Makes the data at the beginning of an evbuffer contiguous.
     unsigned char* pullup(ev_ssize_t len)
     {
@@ -434,6 +463,8 @@ public:
 
     void set_timeout(timeval *timeout_read, timeval *timeout_write);
 
+    void set_watermark(short events, std::size_t lowmark, std::size_t highmark) noexcept;
+
     void write(const void *data, std::size_t size)
     {
         detail::check_result("bufferevent_write",
@@ -630,6 +661,12 @@ public:
         add(&tv);
     }
 
+    // выполнить на следующей итерации цикла
+    void active(short res = EV_TIMEOUT) noexcept
+    {
+        event_active(assert_handle(), res, 0);
+    }
+
     template<class Rep, class Period>
     void add(std::chrono::duration<Rep, Period> timeout)
     {
@@ -637,6 +674,50 @@ public:
     }
 };
 
+// пробуждение очереди из другого потока
+// не требует поддержки потоков в libevent
+// повторные сигналы до обработки склеиваются
+class notify
+{
+    using call_type = void (*)(void*) noexcept;
+
+    evutil_socket_t fd_[2]{ -1, -1 };
+    std::atomic<bool> signaled_{};
+    ev ev_{};
+    call_type call_{};
+    void* arg_{};
+
+    template<class T>
+    static void proxy(void* arg) noexcept
+    {
+        assert(arg);
+        static_cast<ev_timeout_fn<T>*>(arg)->call();
+    }
+
+    static void readcb(evutil_socket_t fd, short, void* arg);
+
+    void create(event_base* queue, call_type fn, void* arg);
+
+public:
+    notify() = default;
+    ~notify() noexcept;
+
+    notify(const notify&) = delete;
+    notify& operator=(const notify&) = delete;
+
+    // обработчик вызывается в потоке очереди
+    template<class T>
+    void create(event_base* queue, ev_timeout_fn<T>& fn)
+    {
+        create(queue, proxy<T>, &fn);
+    }
+
+    void destroy() noexcept;
+
+    // можно вызывать из любого потока
+    void send() noexcept;
+};
+
 timeval gettimeofday_cached(event_base* queue);
 
 template<class T>
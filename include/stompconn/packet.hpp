@@ -4,36 +4,39 @@
 #include "stompconn/header_store.hpp"
 #include "stomptalk/parser.h"
 
-namespace stompconn {
+#include <new>
+#include <memory>
+#include <cstring>
 
-class packet
-{
-protected:
-    const header_store& header_;
-    std::string_view session_{};
-    std::string_view subscription_id_{};
-    std::uint64_t method_{};
-    buffer payload_{};
+namespace stompconn {
 
-public:
-    packet(packet&&) = default;
+class owned_packet;
 
-    packet(const header_store& header, std::string_view session,
-        std::uint64_t method, buffer payload)
-        : header_(header)
-        , session_(session)
-        , method_(method)
-        , payload_(std::move(payload))
-    {   }
+// общие методы доступа к заголовкам
+// T должен иметь get(hash), subscription_id(), for_each(fn),
+// method() и payload()
+template<class T>
+class basic_packet
+{
+    const T& self() const noexcept
+    {
+        return *static_cast<const T*>(this);
+    }
 
-    void set_subscription_id(std::string_view subscription_id) noexcept
+    static void replace_all(std::string &str, const std::string& from, const std::string& to)
     {
-        subscription_id_ = subscription_id;
+        size_t start_pos = 0;
+        while((start_pos = str.find(from, start_pos)) != std::string::npos) 
+        {
+            str.replace(start_pos, from.length(), to);
+            start_pos += to.length();
+        }
     }
 
+public:
     bool error() const noexcept
     {
-        return method_ == st_method_error;
+        return self().method() == st_method_error;
     }
 
     operator bool() const noexcept
@@ -41,115 +44,110 @@ public:
         return !error();
     }
 
-    auto get(std::string_view key) const noexcept
-    {
-        return header_.get(key);
-    }
-
     auto get_content_type() const noexcept
     {
-        return header_.get(st_header_content_type);
+        return self().get(st_header_content_type);
     }
 
     auto get_content_encoding() const noexcept
     {
-        return header_.get(st_header_content_encoding);
+        return self().get(st_header_content_encoding);
     }
 
     auto get_correlation_id() const noexcept
     {
-        return header_.get(st_header_correlation_id);
+        return self().get(st_header_correlation_id);
     }
 
     auto get_reply_to() const noexcept
     {
-        return header_.get(st_header_reply_to);
+        return self().get(st_header_reply_to);
     }
 
     auto get_expires() const noexcept
     {
-        return header_.get(st_header_expires);
+        return self().get(st_header_expires);
     }
 
     auto get_message_id() const noexcept
     {
-        return header_.get(st_header_message_id);
+        return self().get(st_header_message_id);
     }
 
     auto get_amqp_type() const noexcept
     {
-        return header_.get(st_header_amqp_type);
+        return self().get(st_header_amqp_type);
     }
 
     auto get_amqp_message_id() const noexcept
     {
-        return header_.get(st_header_amqp_message_id);
+        return self().get(st_header_amqp_message_id);
     }
 
     auto get_timestamp() const noexcept
     {
-        return header_.get(st_header_timestamp);
+        return self().get(st_header_timestamp);
     }
 
     auto get_user_id() const noexcept
     {
-        return header_.get(st_header_user_id);
+        return self().get(st_header_user_id);
     }
 
     auto get_app_id() const noexcept
     {
-        return header_.get(st_header_app_id);
+        return self().get(st_header_app_id);
     }
 
     auto get_cluster_id() const noexcept
     {
-        return header_.get(st_header_cluster_id);
+        return self().get(st_header_cluster_id);
     }
 
     auto get_ack() const noexcept
     {
-        return header_.get(st_header_ack);
+        return self().get(st_header_ack);
     }
 
     auto get_subscription() const noexcept
     {
-        auto rc = header_.get(st_header_subscription);
+        auto rc = self().get(st_header_subscription);
         if (rc.empty())
         {
             // used for get id from subscribe receipt only!!
-            rc = subscription_id_;
+            rc = self().subscription_id();
         }
         return rc;
     }
 
     auto get_destination() const noexcept
     {
-        return header_.get(st_header_destination);
+        return self().get(st_header_destination);
     }
 
     auto get_id() const noexcept
     {
-        return header_.get(st_header_id);
+        return self().get(st_header_id);
     }
 
     auto get_transaction() const noexcept
     {
-        return header_.get(st_header_transaction);
+        return self().get(st_header_transaction);
     }
 
     auto get_receipt() const noexcept
     {
-        return header_.get(st_header_receipt);
+        return self().get(st_header_receipt);
     }
 
     auto get_receipt_id() const noexcept
     {
-        return header_.get(st_header_receipt_id);
+        return self().get(st_header_receipt_id);
     }
 
     auto get_heart_beat() const noexcept
     {
-        return header_.get(st_header_heart_beat);
+        return self().get(st_header_heart_beat);
     }
 
     bool must_ack() const noexcept
@@ -157,6 +155,102 @@ public:
         return !get_ack().empty();
     }
 
+    std::size_t size() const noexcept
+    {
+        return self().payload().size();
+    }
+
+    std::size_t empty() const noexcept
+    {
+        return self().payload().empty();
+    }
+
+    std::string dump(char m = ' ', char p = ' ', char h = ';') const
+    {
+        std::string rc;
+        std::string_view method{stomptalk_method_str(self().method())};
+        std::string header_dump;
+        header_dump.reserve(320);
+        self().for_each([&](auto hdr) {
+            if (!header_dump.empty())
+                header_dump += h;
+            header_dump += std::get<0>(hdr);
+            header_dump += ':';
+            header_dump += std::get<1>(hdr);
+        });
+        rc.reserve(method.size() + header_dump.size() + size() + 2);
+        rc += method;
+        rc += m;
+        rc += header_dump;
+        rc += p;
+        if (!empty())
+        {
+            auto str = self().payload().str();
+            // rabbitmq issue
+            replace_all(str, "\n", " ");
+            replace_all(str, "\r", " ");
+            replace_all(str, "\t", " ");
+            std::size_t sz = 0;
+            do {
+                sz = str.length();
+                replace_all(str, "  ", " ");
+            } while (sz != str.length());
+
+            rc += str;
+        }
+        return rc;
+    }
+};
+
+// кадр на время вызова обработчика
+// заголовки ссылаются на состояние парсера
+class packet
+    : public basic_packet<packet>
+{
+protected:
+    const header_store& header_;
+    std::string_view session_{};
+    std::string_view subscription_id_{};
+    std::uint64_t method_{};
+    buffer payload_{};
+
+public:
+    packet(packet&&) = default;
+
+    packet(const header_store& header, std::string_view session,
+        std::uint64_t method, buffer payload)
+        : header_(header)
+        , session_(session)
+        , method_(method)
+        , payload_(std::move(payload))
+    {   }
+
+    void set_subscription_id(std::string_view subscription_id) noexcept
+    {
+        subscription_id_ = subscription_id;
+    }
+
+    std::string_view subscription_id() const noexcept
+    {
+        return subscription_id_;
+    }
+
+    auto get(std::string_view key) const noexcept
+    {
+        return header_.get(key);
+    }
+
+    auto get(fnv1a::type num_id) const noexcept
+    {
+        return header_.get(num_id);
+    }
+
+    template<class F>
+    void for_each(F fn) const
+    {
+        header_.for_each(fn);
+    }
+
     std::string_view session() const noexcept
     {
         return session_;
@@ -182,55 +276,170 @@ public:
         return payload();
     }
 
-    std::size_t size() const noexcept
+    // забрать заголовки и тело
+    // результат не зависит от парсера и может передаваться между потоками
+    // тело переносится без копирования
+    owned_packet detach();
+};
+
+// кадр владеющий заголовками
+// заголовки, сессия и идентификатор подписки
+// хранятся в одном выделении памяти
+class owned_packet
+    : public basic_packet<owned_packet>
+{
+    using hash_type = fnv1a::type;
+
+    struct entry_type
+    {
+        hash_type hash{};
+        std::uint32_t key_offset{};
+        std::uint32_t key_size{};
+        std::uint32_t value_offset{};
+        std::uint32_t value_size{};
+    };
+
+    std::unique_ptr<char[]> arena_{};
+    std::size_t count_{};
+    std::string_view session_{};
+    std::string_view subscription_id_{};
+    std::uint64_t method_{};
+    buffer payload_{};
+
+    const entry_type* entry() const noexcept
     {
-        return payload_.size();
+        return reinterpret_cast<const entry_type*>(arena_.get());
     }
 
-    std::size_t empty() const noexcept
+    const char* text() const noexcept
     {
-        return payload_.empty();
+        return arena_.get() + count_ * sizeof(entry_type);
     }
 
-private:    
-    static void replace_all(std::string &str, const std::string& from, const std::string& to)
+    std::string_view key(const entry_type& e) const noexcept
     {
-        size_t start_pos = 0;
-        while((start_pos = str.find(from, start_pos)) != std::string::npos) 
-        {
-            str.replace(start_pos, from.length(), to);
-            start_pos += to.length();
-        }
+        return std::string_view{text() + e.key_offset, e.key_size};
+    }
+
+    std::string_view value(const entry_type& e) const noexcept
+    {
+        return std::string_view{text() + e.value_offset, e.value_size};
     }
 
 public:
-    std::string dump(char m = ' ', char p = ' ', char h = ';') const
+    owned_packet() = default;
+    owned_packet(owned_packet&&) = default;
+    owned_packet& operator=(owned_packet&&) = default;
+
+    owned_packet(const header_store& header, std::string_view session,
+        std::string_view subscription_id, std::uint64_t method,
+        buffer payload);
+
+    std::string_view subscription_id() const noexcept
     {
-        std::string rc;
-        std::string_view method{stomptalk_method_str(method_)};
-        auto header_dump = header_.dump(h);
-        rc.reserve(method.size() + header_dump.size() + size() + 2);
-        rc += method;
-        rc += m;
-        rc += header_dump;
-        rc += p;
-        if (!payload_.empty())
-        {
-            auto str = payload_.str();
-            // rabbitmq issue
-            replace_all(str, "\n", " ");
-            replace_all(str, "\r", " ");
-            replace_all(str, "\t", " ");
-            std::size_t sz = 0;
-            do {
-                sz = str.length();
-                replace_all(str, "  ", " ");
-            } while (sz != str.length());
+        return subscription_id_;
+    }
 
-            rc += str;
+    std::string_view get(std::string_view key) const noexcept
+    {
+        fnv1a h;
+        return get(h(key.data(), key.size()));
+    }
+
+    std::string_view get(hash_type num_id) const noexcept
+    {
+        auto e = entry();
+        for (std::size_t i = 0; i < count_; ++i)
+        {
+            if (e[i].hash == num_id)
+                return value(e[i]);
         }
-        return rc;
+        return {};
+    }
+
+    template<class F>
+    void for_each(F fn) const
+    {
+        auto e = entry();
+        for (std::size_t i = 0; i < count_; ++i)
+            fn(std::make_pair(key(e[i]), value(e[i])));
+    }
+
+    std::string_view session() const noexcept
+    {
+        return session_;
+    }
+
+    auto method() const noexcept
+    {
+        return method_;
+    }
+
+    buffer_ref payload() const noexcept
+    {
+        return buffer_ref(payload_.handle());
+    }
+
+    void copyout(buffer& other)
+    {
+        other.append(std::move(payload_));
+    }
+
+    buffer_ref data() const noexcept
+    {
+        return payload();
     }
 };
 
+inline owned_packet::owned_packet(const header_store& header,
+    std::string_view session, std::string_view subscription_id,
+    std::uint64_t method, buffer payload)
+    : method_(method)
+    , payload_(std::move(payload))
+{
+    // считаем размер
+    std::size_t text_size = session.size() + subscription_id.size();
+    header.for_each([&](auto hdr) {
+        ++count_;
+        text_size += std::get<0>(hdr).size() + std::get<1>(hdr).size();
+    });
+
+    auto entry_size = count_ * sizeof(entry_type);
+    arena_.reset(new char[entry_size + text_size + 1]);
+
+    auto e = reinterpret_cast<entry_type*>(arena_.get());
+    auto base = arena_.get() + entry_size;
+    std::size_t offset = 0;
+    auto store = [&](std::string_view str) {
+        auto rc = static_cast<std::uint32_t>(offset);
+        if (!str.empty())
+            std::memcpy(base + offset, str.data(), str.size());
+        offset += str.size();
+        return rc;
+    };
+
+    fnv1a h;
+    header.for_each([&](auto hdr) {
+        auto k = std::get<0>(hdr);
+        auto v = std::get<1>(hdr);
+        entry_type rc;
+        rc.hash = h(k.data(), k.size());
+        rc.key_size = static_cast<std::uint32_t>(k.size());
+        rc.key_offset = store(k);
+        rc.value_size = static_cast<std::uint32_t>(v.size());
+        rc.value_offset = store(v);
+        new (e++) entry_type(rc);
+    });
+
+    session_ = std::string_view{base + store(session), session.size()};
+    subscription_id_ = std::string_view{
+        base + store(subscription_id), subscription_id.size()};
+}
+
+inline owned_packet packet::detach()
+{
+    return owned_packet(header_, session_, subscription_id_,
+        method_, std::move(payload_));
+}
+
 } // namespace stompconn
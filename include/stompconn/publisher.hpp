@@ -0,0 +1,110 @@
+#pragma once
+
+#include "stompconn/connection.hpp"
+
+#include <deque>
+
+namespace stompconn {
+
+// публикация с подтверждением и ограниченным окном
+// не больше max_count неподтвержденных кадров
+// и не больше max_bytes байт в них
+// сверх окна кадры ставятся в очередь до max_queue
+// или отклоняются если очередь заполнена
+// publisher должен жить пока ожидаются квитанции
+// после отключения соединения нужно вызвать clear
+// пока соединение не принимает кадры, очередь не разбирается
+class publisher
+{
+public:
+    using fn_type = stomplay::fun_type;
+    using on_writable_type = std::function<void()>;
+    using on_error_type = stomplay::on_error_type;
+
+private:
+    using value_type = std::pair<stompconn::send, fn_type>;
+    using queue_type = std::deque<value_type>;
+
+    connection& conn_;
+    std::size_t max_count_{};
+    std::size_t max_bytes_{};
+    std::size_t max_queue_{};
+
+    std::size_t inflight_{};
+    std::size_t inflight_bytes_{};
+    queue_type queue_{};
+
+    on_writable_type on_writable_fn_{};
+    on_error_type on_error_fn_{};
+    // было отказано в отправке
+    bool blocked_{};
+    // меняется в clear, квитанции прошлых окон не учитываются
+    std::size_t generation_{};
+
+    bool window_open(std::size_t size) const noexcept
+    {
+        // один кадр отправляем всегда
+        // даже если он больше окна
+        return (inflight_ == 0) || ((inflight_ < max_count_) &&
+            (!max_bytes_ || (inflight_bytes_ + size <= max_bytes_)));
+    }
+
+    void publish(stompconn::send frame, fn_type fn);
+
+    void exec_receipt(const fn_type& fn, std::size_t size,
+        std::size_t generation, packet p) noexcept;
+
+    void exec_error(std::exception_ptr ex) noexcept;
+
+    void drain();
+
+public:
+    publisher(connection& conn, std::size_t max_count,
+        std::size_t max_bytes = 0, std::size_t max_queue = 0);
+
+    publisher(const publisher&) = delete;
+    publisher& operator=(const publisher&) = delete;
+
+    // true если кадр отправлен или поставлен в очередь
+    // false если окно и очередь заполнены
+    bool send(stompconn::send frame, fn_type fn);
+
+    // можно отправлять без очереди
+    bool writable() const noexcept
+    {
+        return queue_.empty() && window_open(0);
+    }
+
+    // вызывается когда окно освободилось после отказа в send
+    void on_writable(on_writable_type fn)
+    {
+        on_writable_fn_ = std::move(fn);
+    }
+
+    // ошибки обработчиков квитанций и отправки из очереди
+    void on_except(on_error_type fn)
+    {
+        on_error_fn_ = std::move(fn);
+    }
+
+    // сбросить окно и очередь
+    // квитанции после отключения уже не придут
+    void clear() noexcept;
+
+    std::size_t inflight() const noexcept
+    {
+        return inflight_;
+    }
+
+    std::size_t inflight_bytes() const noexcept
+    {
+        return inflight_bytes_;
+    }
+
+    std::size_t queued() const noexcept
+    {
+        return queue_.size();
+    }
+};
+
+} // namespace stompconn
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <new>
+#include <atomic>
+#include <memory>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+namespace stompconn {
+
+// ограниченная очередь без блокировок
+// много писателей и много читателей
+// память выделяется один раз при создании
+// D. Vyukov bounded MPMC queue
+template<class T>
+class bounded_queue
+{
+    struct cell_type
+    {
+        std::atomic<std::size_t> sequence{};
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type data;
+
+        T* value() noexcept
+        {
+            return reinterpret_cast<T*>(&data);
+        }
+    };
+
+    constexpr static std::size_t cache_line = 64;
+
+    std::unique_ptr<cell_type[]> cell_{};
+    std::size_t mask_{};
+    alignas(cache_line) std::atomic<std::size_t> enqueue_pos_{};
+    alignas(cache_line) std::atomic<std::size_t> dequeue_pos_{};
+
+public:
+    // size - степень двойки
+    explicit bounded_queue(std::size_t size)
+        : cell_(new cell_type[size])
+        , mask_(size - 1)
+    {
+        if ((size < 2) || (size & (size - 1)))
+            throw std::logic_error("bounded_queue size");
+
+        for (std::size_t i = 0; i < size; ++i)
+            cell_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    ~bounded_queue()
+    {
+        T val;
+        while (pop(val))
+            ;
+    }
+
+    // false если очередь заполнена
+    // при неудаче value не перемещается
+    bool push(T& value)
+    {
+        cell_type* cell;
+        auto pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cell_[pos & mask_];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto dif = static_cast<std::ptrdiff_t>(seq) -
+                static_cast<std::ptrdiff_t>(pos);
+            if (dif == 0)
+            {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;
+            else
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+
+        new (cell->value()) T(std::move(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false если очередь пуста
+    bool pop(T& value)
+    {
+        cell_type* cell;
+        auto pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &cell_[pos & mask_];
+            auto seq = cell->sequence.load(std::memory_order_acquire);
+            auto dif = static_cast<std::ptrdiff_t>(seq) -
+                static_cast<std::ptrdiff_t>(pos + 1);
+            if (dif == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;
+            else
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+        }
+
+        auto ptr = cell->value();
+        value = std::move(*ptr);
+        ptr->~T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const noexcept
+    {
+        return enqueue_pos_.load(std::memory_order_acquire) ==
+            dequeue_pos_.load(std::memory_order_acquire);
+    }
+};
+
+} // namespace stompconn
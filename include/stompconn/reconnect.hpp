@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <random>
+#include <cstddef>
+
+namespace stompconn {
+
+// политика переподключения
+// предел задержки растет от min_delay в multiplier раз с каждой попыткой
+// до max_delay, сама задержка выбирается случайно в [min_delay, предел]
+// чтобы клиенты не переподключались одновременно
+struct reconnect_policy
+{
+    std::chrono::milliseconds min_delay{ 100 };
+    std::chrono::milliseconds max_delay{ 30000 };
+    double multiplier{ 2.0 };
+    // 0 - без ограничения
+    std::size_t max_attempts{};
+    // повторять неподтвержденные send
+    bool replay{ true };
+};
+
+class backoff
+{
+    reconnect_policy policy_{};
+    std::size_t attempt_{};
+    std::minstd_rand rand_{};
+
+public:
+    backoff() = default;
+
+    explicit backoff(const reconnect_policy& policy);
+
+    const reconnect_policy& policy() const noexcept
+    {
+        return policy_;
+    }
+
+    // задержка следующей попытки
+    std::chrono::milliseconds next();
+
+    // попытки исчерпаны
+    bool exhausted() const noexcept
+    {
+        return policy_.max_attempts && (attempt_ >= policy_.max_attempts);
+    }
+
+    std::size_t attempt() const noexcept
+    {
+        return attempt_;
+    }
+
+    void reset() noexcept
+    {
+        attempt_ = 0;
+    }
+};
+
+} // namespace stompconn
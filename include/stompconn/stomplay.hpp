@@ -7,6 +7,7 @@
 #include "stomptalk/parser.hpp"
 #include "stomptalk/hook_base.hpp"
 
+#include <map>
 #include <array>
 
 namespace stompconn {
@@ -18,6 +19,8 @@ public:
     using fun_type = std::function<void(packet)>;
     using text_type = basic_text<char, 20>;
     using on_error_type = std::function<void(std::exception_ptr)>;
+    using body_fun_type = subscribe::body_fn_type;
+    using body_event = subscribe::body_event;
 
 private:
     stomptalk::parser stomp_{};
@@ -29,6 +32,10 @@ private:
     std::string current_header_{};
 
     buffer recv_{};
+    // входной буфер при разборе без копирования тела
+    buffer_ref input_{};
+    const char* input_ptr_{};
+    std::size_t input_removed_{};
     fun_type on_logon_fn_{};
     fun_type on_error_fn_{};
     std::string session_{};
@@ -36,6 +43,13 @@ private:
     receipt_handler receipt_{};
     subscription_handler subscription_{};
 
+    // обработчики тела потоковых подписок
+    std::map<std::string, body_fun_type, std::less<>> stream_{};
+    // обработчик тела текущего кадра
+    // копия, подписку могут удалить во время приема тела
+    body_fun_type streaming_{};
+    bool stream_checked_{};
+
 #ifdef STOMPCONN_DEBUG
     std::string dump_{};
 #endif
@@ -64,6 +78,17 @@ private:
     void exec_on_receipt(std::string_view id) noexcept;
     void exec_on_message(std::string_view id) noexcept;
 
+    // определить потоковую подписку текущего MESSAGE
+    // заголовки отдаются обработчику подписки сразу
+    void start_stream() noexcept;
+    void exec_on_body(buffer chunk, body_event event) noexcept;
+
+    // сообщить обработчику об оборванном теле
+    void abort_stream() noexcept;
+
+    // перенести тело из входного буфера или скопировать
+    void take_body(buffer& dst, const void* data, std::size_t size);
+
     void clear();
 
 public:
@@ -79,6 +104,11 @@ public:
         return stomp_.run(hook_, ptr, size);
     }
 
+    // parse contiguous data at the beginning of input
+    // body chains are moved from input to packet without copying
+    // parsed data is removed from input
+    std::size_t parse(buffer_ref input, const char* ptr, std::size_t size);
+
     void on_logon(fun_type fn)
     {
         on_logon_fn_ = std::move(fn);
@@ -94,11 +124,15 @@ public:
         return stomptalk_get_error_str(hook_.error());
     }
 
+    // сброс при переподключении
+    // обработчики подписок сохраняются
+    void reset();
+
     void logout();
 
-    std::string_view add_receipt(frame& frame, fun_type fn);
+    text_type add_receipt(frame& frame, fun_type fn);
 
-    std::string_view add_handler(frame &frame, fun_type fn)
+    text_type add_handler(frame &frame, fun_type fn)
     {
         return add_receipt(frame, std::move(fn));
     }
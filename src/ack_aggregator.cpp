@@ -0,0 +1,58 @@
+#include "stompconn/ack_aggregator.hpp"
+
+#include <stdexcept>
+
+using namespace stompconn;
+
+void ack_aggregator::setup(std::string_view subscription_id,
+    std::size_t max_count, duration max_delay)
+{
+    if (subscription_id.empty())
+        throw std::runtime_error("subscription id empty");
+
+    if (!max_count)
+        throw std::runtime_error("ack max count empty");
+
+    auto f = state_.find(subscription_id);
+    if (f == state_.end())
+        f = state_.emplace(std::string{subscription_id}, state_type()).first;
+
+    auto& state = std::get<1>(*f);
+    state.max_count = max_count;
+    state.max_delay = max_delay;
+}
+
+ack_aggregator::time_point ack_aggregator::push(
+    std::string_view subscription_id, std::string_view ack_id, time_point now)
+{
+    auto f = state_.find(subscription_id);
+    if (f == state_.end())
+        return time_point::max();
+
+    auto& state = std::get<1>(*f);
+    // последний id подтверждает все предыдущие
+    state.ack_id = ack_id;
+    ++state.stat.messages;
+
+    if (!state.pending++)
+        state.first = now;
+
+    if (state.pending >= state.max_count)
+        return now;
+
+    return state.first + state.max_delay;
+}
+
+void ack_aggregator::remove(std::string_view subscription_id) noexcept
+{
+    auto f = state_.find(subscription_id);
+    if (f != state_.end())
+        state_.erase(f);
+}
+
+const ack_aggregator::stat_type* ack_aggregator::stat(
+    std::string_view subscription_id) const noexcept
+{
+    auto f = state_.find(subscription_id);
+    return (f != state_.end()) ? &std::get<1>(*f).stat : nullptr;
+}
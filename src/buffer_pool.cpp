@@ -0,0 +1,108 @@
+#include "stompconn/buffer_pool.hpp"
+
+#include <vector>
+
+using namespace stompconn;
+
+namespace {
+
+struct pool_state
+{
+    std::vector<evbuffer*> free{};
+    std::size_t capacity{};
+    buffer_pool::stat_type stat{};
+
+    void shrink(std::size_t size) noexcept
+    {
+        while (free.size() > size)
+        {
+            evbuffer_free(free.back());
+            free.pop_back();
+        }
+    }
+
+    ~pool_state();
+};
+
+// указатель без деструктора
+// буферы удаляемые после завершения потока минуют пул
+thread_local pool_state* current = nullptr;
+
+pool_state::~pool_state()
+{
+    current = nullptr;
+    shrink(0);
+}
+
+pool_state& state()
+{
+    thread_local pool_state pool;
+    if (!current)
+        current = &pool;
+    return pool;
+}
+
+} // namespace
+
+void buffer_pool::reserve(std::size_t capacity)
+{
+    auto& pool = state();
+    pool.capacity = capacity;
+    pool.shrink(capacity);
+    pool.free.reserve(capacity);
+}
+
+std::size_t buffer_pool::capacity() noexcept
+{
+    return current ? current->capacity : 0;
+}
+
+std::size_t buffer_pool::size() noexcept
+{
+    return current ? current->free.size() : 0;
+}
+
+buffer_pool::stat_type buffer_pool::stat() noexcept
+{
+    return current ? current->stat : stat_type();
+}
+
+evbuffer* buffer_pool::acquire() noexcept
+{
+    auto pool = current;
+    if (!(pool && pool->capacity))
+        return nullptr;
+
+    if (pool->free.empty())
+    {
+        ++pool->stat.miss;
+        return nullptr;
+    }
+
+    ++pool->stat.hit;
+    auto ptr = pool->free.back();
+    pool->free.pop_back();
+    return ptr;
+}
+
+bool buffer_pool::release(evbuffer* ptr) noexcept
+{
+    auto pool = current;
+    if (!(pool && pool->capacity))
+        return false;
+
+    if (pool->free.size() >= pool->capacity)
+    {
+        ++pool->stat.drop;
+        return false;
+    }
+
+    // освобождаем цепочки и ссылки (append_ref)
+    // сам буфер остается пригодным
+    if (evbuffer_drain(ptr, evbuffer_get_length(ptr)) == -1)
+        return false;
+
+    // емкость зарезервирована в reserve
+    pool->free.push_back(ptr);
+    return true;
+}
@@ -1,6 +1,7 @@
 #include "stompconn/connection.hpp"
 #include "stompconn/conv.hpp"
 #include <random>
+#include <charconv>
 #ifdef STOMPCONN_DEBUG
 #include <iostream>
 #endif
@@ -16,14 +17,28 @@ void connection::do_evcb(short what) noexcept
         try
         {
             update_connection_id();
-            on_connect_fun_();
-            bev_.enable(EV_READ);
+            if (reconnecting_ && !logon_.empty())
+                do_relogon();
+            else
+            {
+                reconnecting_ = false;
+                on_connect_fun_();
+            }
+            if (reading())
+                bev_.enable(EV_READ);
         }
         catch(...)
         {
             exec_error(std::current_exception());
         }        
     }
+    else if (reconnect_ && !closing_)
+    {
+        teardown();
+        stomplay_.reset();
+
+        schedule_reconnect(what);
+    }
     else
     {
         disconnect();
@@ -32,35 +47,214 @@ void connection::do_evcb(short what) noexcept
     }
 }
 
-void connection::setup_write_timeout(std::size_t timeout, double tolerant)
+void connection::reconnect(const reconnect_policy& policy)
+{
+    reconnect_ = std::make_unique<backoff>(policy);
+}
+
+void connection::schedule_reconnect(short what) noexcept
+{
+    try
+    {
+        assert(reconnect_);
+
+        if (reconnect_->exhausted())
+        {
+            disconnect();
+            exec_event_fun(what);
+            return;
+        }
+
+        reconnecting_ = true;
+
+        if (reconnect_ev_.empty())
+        {
+            reconnect_ev_.create(queue_, -1, EV_TIMEOUT,
+                proxy<connection>::reconnect, this);
+        }
+
+        reconnect_ev_.add(reconnect_->next());
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+}
+
+void connection::do_reconnect() noexcept
+{
+    try
+    {
+        if (!endpoints_.empty())
+        {
+            start_connector();
+            return;
+        }
+
+        create();
+        if (connect_timeout_.tv_sec || connect_timeout_.tv_usec)
+            bev_.set_timeout(nullptr, &connect_timeout_);
+        connecting_ = true;
+        bev_.connect(dns_, host_, port_);
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+
+        // ошибка могла уже прийти через калбек
+        if (reconnect_ev_.empty() ||
+            !event_pending(reconnect_ev_, EV_TIMEOUT, nullptr))
+        {
+            teardown();
+            schedule_reconnect(BEV_EVENT_ERROR);
+        }
+    }
+}
+
+void connection::do_relogon()
+{
+    replay_frame frame(logon_);
+
+    stomplay_.on_logon([this](packet p) {
+        exec_relogon(std::move(p));
+    });
+
+    write(frame);
+}
+
+void connection::exec_relogon(packet p) noexcept
 {
-    if (timeout)
+    try
     {
-        if (timeout_.empty())
+        if (!p)
+        {
+            teardown();
+            stomplay_.reset();
+            schedule_reconnect(BEV_EVENT_ERROR);
+            return;
+        }
+
+        setup_heart_beat(p);
+
+        // обработчики подписок сохранились в stomplay
+        for (auto& [id, headers] : resubscribe_)
+        {
+            replay_frame frame(headers);
+            frame.push(header::id(id));
+            write(frame);
+        }
+
+        reconnecting_ = false;
+
+        if (reconnect_->policy().replay)
         {
-            timeout_.create(queue_, EV_PERSIST|EV_TIMEOUT,
-                proxy<connection>::heart_beat, this);
+            for (auto& [seq_id, replay] : replay_)
+            {
+                replay_frame frame(replay.headers, replay.payload);
+                stomplay_.add_handler(frame, [this, id = seq_id](packet p) {
+                    exec_replay(id, std::move(p));
+                });
+                write(frame);
+            }
         }
+        else
+            replay_.clear();
+
+        reconnect_->reset();
 
-        // because of timing inaccuracies, the receiver
-        // SHOULD be tolerant and take into account an error margin
-        // они должны быть толерантными
-        timeout = static_cast<std::size_t>(timeout * tolerant);
-        timeout_.add(std::chrono::milliseconds(timeout));
+        if (on_reconnect_fun_)
+            on_reconnect_fun_();
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
     }
 }
 
-void connection::setup_read_timeout(std::size_t timeout, double tolerant)
+void connection::exec_replay(std::size_t seq_id, packet p) noexcept
 {
-    if (timeout)
+    try
     {
-        // because of timing inaccuracies, the receiver
-        // SHOULD be tolerant and take into account an error margin
-        // нужно быть толерантным
-        timeout = static_cast<std::size_t>(timeout * tolerant);
-        auto tv = detail::make_timeval(
-            std::chrono::milliseconds(timeout));
-        bev_.set_timeout(&tv, nullptr);
+        auto f = replay_.find(seq_id);
+        if (f == replay_.end())
+            return;
+
+        auto fn = std::move(f->second.fn);
+        replay_.erase(f);
+
+        fn(std::move(p));
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+}
+
+void connection::setup_heart_beat_timer()
+{
+    // because of timing inaccuracies, the receiver
+    // SHOULD be tolerant and take into account an error margin
+    // пишем чаще, ждем дольше
+    write_interval_ = static_cast<std::size_t>(write_timeout_ * 0.9);
+    read_interval_ = static_cast<std::size_t>(read_timeout_ * 1.3);
+
+    // один таймер на запись и чтение
+    // за интервал записи он срабатывает минимум дважды
+    std::size_t tick = 0;
+    if (write_interval_)
+        tick = write_interval_ / 2;
+    if (read_interval_)
+        tick = tick ? (std::min)(tick, read_interval_ / 2) : read_interval_ / 2;
+
+    timeout_.destroy();
+    heart_beat_tick_ = (std::max)(tick, std::size_t(1));
+    if (!tick)
+        return;
+
+    last_writed_ = bytes_writed_;
+    last_readed_ = bytes_readed_;
+    write_idle_ = 0;
+    read_idle_ = 0;
+
+    timeout_.create(queue_, EV_PERSIST|EV_TIMEOUT,
+        proxy<connection>::heart_beat, this);
+    timeout_.add(std::chrono::milliseconds(heart_beat_tick_));
+}
+
+void connection::do_heart_beat() noexcept
+{
+    // запись и чтение только меняют счетчики байт
+    // здесь проверяем менялись ли они с прошлого срабатывания
+    if (read_interval_)
+    {
+        // при паузе чтения данные сервера не разбираются
+        // тишину на это время не считаем
+        if (!reading() || (bytes_readed_ != last_readed_))
+        {
+            last_readed_ = bytes_readed_;
+            read_idle_ = 0;
+        }
+        else if (++read_idle_ * heart_beat_tick_ >= read_interval_)
+        {
+            do_evcb(BEV_EVENT_TIMEOUT|BEV_EVENT_READING);
+            return;
+        }
+    }
+
+    if (write_interval_)
+    {
+        // пинг учтется как запись на следующем срабатывании
+        auto writed = bytes_writed_;
+        if (writed != last_writed_)
+            write_idle_ = 0;
+        // последняя запись могла быть сразу после прошлого срабатывания
+        // к следующему пройдет больше интервала
+        else if ((++write_idle_ + 1) * heart_beat_tick_ >= write_interval_)
+        {
+            send_heart_beat();
+            write_idle_ = 0;
+        }
+        last_writed_ = writed;
     }
 }
 
@@ -72,7 +266,8 @@ void connection::do_recv(buffer_ref input) noexcept
         // буферэвент должен отрабоать дисконнект
         assert(!input.empty());
 
-        while (!input.empty())
+        // чтение могло быть приостановлено из обработчиков
+        while (!input.empty() && reading())
         {
             // сколько непрерывных данных мы имеем
             auto needle = input.contiguous_space();
@@ -86,7 +281,9 @@ void connection::do_recv(buffer_ref input) noexcept
                 std::cout << "recv ping" << std::endl;
 #endif // DEBUG
             // парсим данные
-            auto rc = stomplay_.parse(ptr, needle);
+            // тело сообщения переносится из input без копирования
+            // пропарсенные данные удаляются из input
+            auto rc = stomplay_.parse(input, ptr, needle);
 
             // если не все пропарсилось
             // это ошибка
@@ -103,15 +300,6 @@ void connection::do_recv(buffer_ref input) noexcept
                 do_evcb(BEV_EVENT_ERROR);
                 return;
             }
-            else
-            {
-                // очищаем input
-                // сколько пропарсили
-                input.drain(rc);
-
-                // перезаводим таймер чтения
-                setup_read_timeout(read_timeout_);
-            }
         }
 
         return;
@@ -178,10 +366,13 @@ void connection::create()
     bev_.create(queue_, -1);
 
     bev_.set(&proxy<connection>::recvcb,
-        nullptr, &proxy<connection>::evcb, this);
+        &proxy<connection>::writecb, &proxy<connection>::evcb, this);
+    bev_.set_watermark(EV_WRITE, write_lowmark_, 0);
+    bev_.set_watermark(EV_READ, read_lowmark_, read_highmark_);
 
     write_timeout_ = 0;
     read_timeout_ = 0;
+    closing_ = false;
 }
 
 #ifdef STOMPCONN_OPENSSL
@@ -196,32 +387,346 @@ void connection::create(struct ssl_st *ssl)
     bev_.create(queue_, -1, ssl);
 
     bev_.set(&proxy<connection>::recvcb,
-        nullptr, &proxy<connection>::evcb, this);
+        &proxy<connection>::writecb, &proxy<connection>::evcb, this);
+    bev_.set_watermark(EV_WRITE, write_lowmark_, 0);
+    bev_.set_watermark(EV_READ, read_lowmark_, read_highmark_);
 
     write_timeout_ = 0;
     read_timeout_ = 0;
+    closing_ = false;
 }
 #endif
 #endif
 
+static std::size_t parse_heart_beat(std::string_view val) noexcept
+{
+    std::size_t rc = 0;
+    auto b = val.data();
+    auto e = b + val.size();
+    // пробелы допустимы
+    while ((b < e) && (*b == ' '))
+        ++b;
+    std::from_chars(b, e, rc);
+    return rc;
+}
+
 void connection::setup_heart_beat(const packet& logon)
 {
+    // сервер: sx - может слать, sy - хочет получать
+    // heart-beat согласуется только если его хотят обе стороны
+    // интервал - больший из предложенных
+    std::size_t sx = 0;
+    std::size_t sy = 0;
     auto h = logon.get_heart_beat();
-    if (!h.empty())
+    auto f = h.find(',');
+    if (f != std::string_view::npos)
     {
-        using namespace std::literals;
-        auto f = h.find(","sv);
-        if (f != std::string_view::npos)
+        sx = parse_heart_beat(h.substr(0, f));
+        sy = parse_heart_beat(h.substr(f + 1));
+    }
+
+    write_timeout_ = (heart_beat_cx_ && sy) ?
+        (std::max)(heart_beat_cx_, sy) : 0;
+    read_timeout_ = (heart_beat_cy_ && sx) ?
+        (std::max)(heart_beat_cy_, sx) : 0;
+
+    setup_heart_beat_timer();
+}
+
+void connection::check_connected() const
+{
+    // во время переподключения bufferevent уже удален
+    if (!bev_.handle())
+        throw std::runtime_error("not connected");
+}
+
+void connection::write(frame& frame)
+{
+    check_connected();
+
+    if (!batch_max_frames_)
+    {
+        bytes_writed_ += frame.write(bev_);
+        check_congested();
+        return;
+    }
+
+    auto data = frame.data();
+    auto size = data.size();
+    batch_.append(std::move(data));
+    bytes_writed_ += size;
+
+    if ((++batch_pending_ >= batch_max_frames_) ||
+        (batch_max_bytes_ && (batch_.size() >= batch_max_bytes_)))
+    {
+        flush();
+    }
+    else if (batch_pending_ == 1)
+    {
+        // отправим на следующей итерации цикла
+        if (batch_ev_.empty())
+            batch_ev_.create(queue_, 0, proxy<connection>::flush, this);
+        batch_ev_.active();
+    }
+}
+
+void connection::do_flush() noexcept
+{
+    try
+    {
+        if (bev_.handle())
+            flush();
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+}
+
+void connection::batch(std::size_t max_frames, std::size_t max_bytes)
+{
+    // при выключении отправляем накопленное
+    if (!max_frames && bev_.handle())
+        flush();
+
+    batch_max_frames_ = max_frames;
+    batch_max_bytes_ = max_bytes;
+}
+
+void connection::flush()
+{
+    if (batch_pending_ && bev_.handle())
+    {
+        bev_.write(batch_.handle());
+        batch_frames_ += batch_pending_;
+        batch_pending_ = 0;
+        ++batch_writes_;
+        check_congested();
+    }
+}
+
+void connection::post_queue(std::size_t size)
+{
+    if (post_)
+        throw std::logic_error("post queue exists");
+
+    auto q = std::make_unique<bounded_queue<evbuffer*>>(size);
+    post_notify_.create(queue_, post_fn_);
+    post_ = std::move(q);
+    post_size_ = size;
+}
+
+bool connection::post_frame(frame& frame) noexcept
+{
+    if (!post_)
+        return false;
+
+    auto data = frame.release();
+    if (!post_->push(data))
+    {
+        detail::mem_buffer::free(data);
+        return false;
+    }
+
+    post_notify_.send();
+    return true;
+}
+
+void connection::do_post() noexcept
+{
+    try
+    {
+        auto size = batch_.size();
+        std::size_t count = 0;
+        evbuffer* data;
+        // не больше размера очереди за один вызов
+        // чтобы писатели не задерживали цикл
+        while ((count < post_size_) && post_->pop(data))
+        {
+            // после отключения кадры отбрасываются
+            buffer_ref ref(data);
+            if (bev_.handle())
+                batch_.append(ref);
+            detail::mem_buffer::free(data);
+            ++count;
+        }
+
+        if (count == post_size_)
+            post_notify_.send();
+
+        if (count && bev_.handle())
+        {
+            bytes_writed_ += batch_.size() - size;
+            batch_pending_ += count;
+            flush();
+        }
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+}
+
+void connection::write_watermark(std::size_t lowmark, std::size_t highmark)
+{
+    if (highmark && (lowmark >= highmark))
+        throw std::logic_error("write lowmark above highmark");
+
+    write_lowmark_ = lowmark;
+    write_highmark_ = highmark;
+
+    if (bev_.handle())
+    {
+        bev_.set_watermark(EV_WRITE, write_lowmark_, 0);
+        check_congested();
+    }
+}
+
+void connection::read_watermark(std::size_t lowmark, std::size_t highmark)
+{
+    if (highmark && (lowmark >= highmark))
+        throw std::logic_error("read lowmark above highmark");
+
+    read_lowmark_ = lowmark;
+    read_highmark_ = highmark;
+
+    if (bev_.handle())
+        bev_.set_watermark(EV_READ, read_lowmark_, read_highmark_);
+}
+
+void connection::update_reading()
+{
+    if (!bev_.handle() || connecting_)
+        return;
+
+    if (!reading())
+    {
+        bev_.disable(EV_READ);
+        return;
+    }
+
+    bev_.enable(EV_READ);
+
+    // во входном буфере могли остаться данные
+    // новых данных из сокета может не быть
+    if (!bev_.input().empty())
+    {
+        if (read_resume_.empty())
         {
-            read_timeout_ = static_cast<std::size_t>(
-                std::atoll(h.data()));
+            read_resume_.create(queue_, 0,
+                proxy<connection>::read_resume, this);
+        }
+        read_resume_.active();
+    }
+}
+
+void connection::do_read_resume() noexcept
+{
+    if (bev_.handle() && reading())
+    {
+        auto input = bev_.input();
+        if (!input.empty())
+            do_recv(input);
+    }
+}
+
+void connection::pause_reading()
+{
+    read_paused_ = true;
+    update_reading();
+}
+
+void connection::resume_reading()
+{
+    read_paused_ = false;
+    update_reading();
+}
 
-            setup_read_timeout(read_timeout_);
+void connection::pending_limit(std::size_t max_pending)
+{
+    pending_limit_ = max_pending;
 
-            write_timeout_ = static_cast<std::size_t>(
-                std::atoll(h.substr(f + 1).data()));
+    pending_overloaded_ = 0;
+    if (pending_limit_)
+    {
+        for (auto& p : pending_)
+        {
+            if (std::get<1>(p) > pending_limit_)
+                ++pending_overloaded_;
+        }
+    }
+
+    read_auto_paused_ = pending_overloaded_ > 0;
+    update_reading();
+}
+
+void connection::hold(std::string_view subscription_id)
+{
+    auto f = pending_.find(subscription_id);
+    if (f == pending_.end())
+        f = pending_.emplace(std::string{subscription_id}, 0).first;
+
+    auto count = ++std::get<1>(*f);
+    if (pending_limit_ && (count == pending_limit_ + 1))
+    {
+        if (!pending_overloaded_++)
+        {
+            read_auto_paused_ = true;
+            update_reading();
+        }
+    }
+}
+
+void connection::release(std::string_view subscription_id)
+{
+    auto f = pending_.find(subscription_id);
+    if ((f == pending_.end()) || !std::get<1>(*f))
+        return;
+
+    auto count = std::get<1>(*f)--;
+    if (pending_limit_ && (count == pending_limit_ + 1))
+    {
+        assert(pending_overloaded_);
+        if (!--pending_overloaded_)
+        {
+            read_auto_paused_ = false;
+            update_reading();
+        }
+    }
+}
+
+void connection::check_congested() noexcept
+{
+    if (!congested_ && write_highmark_ &&
+        (bev_.output().size() > write_highmark_))
+    {
+        congested_ = true;
+        try
+        {
+            if (on_congested_fun_)
+                on_congested_fun_();
+        }
+        catch (...)
+        {
+            exec_error(std::current_exception());
+        }
+    }
+}
 
-            setup_write_timeout(write_timeout_);
+void connection::do_writable() noexcept
+{
+    // выходной буфер опустел до lowmark
+    if (congested_)
+    {
+        congested_ = false;
+        try
+        {
+            if (on_writable_fun_)
+                on_writable_fun_();
+        }
+        catch (...)
+        {
+            exec_error(std::current_exception());
         }
     }
 }
@@ -229,10 +734,80 @@ void connection::setup_heart_beat(const packet& logon)
 connection::~connection()
 {
     disconnect();
+
+    post_notify_.destroy();
+    if (post_)
+    {
+        evbuffer* data;
+        while (post_->pop(data))
+            detail::mem_buffer::free(data);
+    }
+}
+
+void connection::connect(evdns_base* dns,
+    std::vector<endpoint> endpoints, std::chrono::milliseconds stagger)
+{
+    connect(dns, std::move(endpoints), stagger, timeval{0, 0});
+}
+
+void connection::connect(evdns_base* dns, std::vector<endpoint> endpoints,
+    std::chrono::milliseconds stagger, timeval timeout)
+{
+    if (endpoints.empty())
+        throw std::runtime_error("endpoints empty");
+
+    dns_ = dns;
+    endpoints_ = std::move(endpoints);
+    stagger_ = stagger;
+    connect_timeout_ = timeout;
+
+    start_connector();
+}
+
+void connection::start_connector()
+{
+    bev_.destroy();
+    timeout_.destroy();
+
+    closing_ = false;
+
+    // connector можно удалять и из его калбека
+    connector_ = std::make_unique<connector>(queue_, dns_, stagger_,
+        connect_timeout_, [this](bev hbev, short what) {
+            do_connector(std::move(hbev), what);
+    });
+    connecting_ = true;
+    connector_->start(endpoints_);
+}
+
+void connection::do_connector(bev hbev, short what) noexcept
+{
+    if (!hbev.handle())
+    {
+        do_evcb(what);
+        return;
+    }
+
+    bev_ = std::move(hbev);
+    bev_.set(&proxy<connection>::recvcb,
+        &proxy<connection>::writecb, &proxy<connection>::evcb, this);
+    bev_.set_watermark(EV_WRITE, write_lowmark_, 0);
+    bev_.set_watermark(EV_READ, read_lowmark_, read_highmark_);
+
+    write_timeout_ = 0;
+    read_timeout_ = 0;
+
+    do_evcb(what);
 }
 
 void connection::connect(evdns_base* dns, const std::string& host, int port)
 {
+    endpoints_.clear();
+    dns_ = dns;
+    host_ = host;
+    port_ = port;
+    connect_timeout_ = timeval{0, 0};
+
     create();
     connecting_ = true;
     // при работе с bev этот вызов должен быть посленим 
@@ -242,6 +817,12 @@ void connection::connect(evdns_base* dns, const std::string& host, int port)
 
 void connection::connect(evdns_base* dns, const std::string& host, int port, timeval timeout)
 {
+    endpoints_.clear();
+    dns_ = dns;
+    host_ = host;
+    port_ = port;
+    connect_timeout_ = timeout;
+
     create();
     bev_.set_timeout(nullptr, &timeout);
     connecting_ = true;
@@ -254,6 +835,17 @@ void connection::unsubscribe(std::string_view id, stomplay::fun_type real_fn)
 {
     assert(real_fn);
 
+    check_connected();
+
+    // подтверждаем накопленное до отписки
+    ack_flush(id);
+    ack_aggregator_.remove(id);
+
+    // после переподключения не повторяем
+    auto r = resubscribe_.find(id);
+    if (r != resubscribe_.end())
+        resubscribe_.erase(r);
+
     frame frame;
     frame.push(stompconn::method::unsubscribe());
     frame.push(stompconn::header::id(id));
@@ -263,23 +855,61 @@ void connection::unsubscribe(std::string_view id, stomplay::fun_type real_fn)
           exec_unsubscribe(fn, id, std::move(p));
     });
 
-    setup_write_timeout(write_timeout_);
-
-    bytes_writed_ += frame.write(bev_);
+    write(frame);
 }
 
 void connection::disconnect() noexcept
+{
+    reconnecting_ = false;
+    closing_ = false;
+    reconnect_ev_.destroy();
+    if (reconnect_)
+        reconnect_->reset();
+    logon_.clear();
+    resubscribe_.clear();
+    replay_.clear();
+    ack_aggregator_.clear();
+
+    teardown();
+
+    try
+    {
+        stomplay_.logout();
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+}
+
+void connection::teardown() noexcept
 {
     try
     {
+        connector_.reset();
         connecting_ = false;
         bytes_readed_ = 0;
         bytes_writed_ = 0;
 
         timeout_.destroy();
 
-        stomplay_.logout();
-        
+        // неотправленные кадры теряются вместе с соединением
+        batch_.drain(batch_.size());
+        batch_pending_ = 0;
+
+        ack_timer_.destroy();
+        ack_deadline_ = ack_aggregator::time_point::max();
+        // настройки накопительного ACK нужны повторенным подпискам
+        ack_aggregator_.reset();
+
+        congested_ = false;
+
+        // сообщения в обработке относятся к старому соединению
+        // ручная пауза сохраняется
+        read_auto_paused_ = false;
+        pending_.clear();
+        pending_overloaded_ = 0;
+
         bev_.destroy();
 
     }
@@ -293,12 +923,19 @@ void connection::logout(stomplay::fun_type fn)
 {
     assert(fn);
 
+    check_connected();
+
     frame frame;
     frame.push(stompconn::method::disconnect());
 
+    // брокер закроет соединение после квитанции
+    // это штатное отключение, а не обрыв
+    closing_ = true;
+    logon_.clear();
+
     stomplay_.add_handler(frame, std::move(fn));
 
-    bytes_writed_ += frame.write(bev_);
+    write(frame);
 }
 
 // some helpers
@@ -323,6 +960,90 @@ void connection::ack(const packet& p,
     send(std::move(frame), std::move(fn));
 }
 
+void connection::send_ack(std::string_view ack_id)
+{
+    send(stompconn::ack(ack_id));
+}
+
+void connection::ack_cumulative(std::string_view subscription_id,
+    std::size_t max_count, ack_aggregator::duration max_delay)
+{
+    ack_aggregator_.setup(subscription_id, max_count, max_delay);
+}
+
+void connection::ack_cumulative(const packet& p)
+{
+    auto subscription_id = p.get_subscription();
+    auto ack_id = get_ack_id(p);
+
+    auto now = ack_aggregator::clock::now();
+    auto deadline = ack_aggregator_.push(subscription_id, ack_id, now);
+    if (deadline == ack_aggregator::time_point::max())
+    {
+        // подписка не настроена
+        send_ack(ack_id);
+    }
+    else if (deadline <= now)
+    {
+        ack_flush(subscription_id);
+    }
+    else
+        setup_ack_timeout(deadline, now);
+}
+
+void connection::ack_flush(std::string_view subscription_id)
+{
+    ack_aggregator_.flush(subscription_id, [this](std::string_view ack_id) {
+        send_ack(ack_id);
+    });
+}
+
+void connection::ack_flush()
+{
+    ack_aggregator_.flush([this](std::string_view ack_id) {
+        send_ack(ack_id);
+    });
+}
+
+void connection::setup_ack_timeout(ack_aggregator::time_point deadline,
+    ack_aggregator::time_point now)
+{
+    // таймер уже заведен на более ранний срок
+    if (deadline >= ack_deadline_)
+        return;
+
+    if (ack_timer_.empty())
+    {
+        ack_timer_.create(queue_, EV_TIMEOUT,
+            proxy<connection>::ack_timeout, this);
+    }
+
+    ack_deadline_ = deadline;
+    ack_timer_.add(std::chrono::duration_cast<
+        std::chrono::microseconds>(deadline - now));
+}
+
+void connection::do_ack_timeout() noexcept
+{
+    try
+    {
+        ack_deadline_ = ack_aggregator::time_point::max();
+
+        auto now = ack_aggregator::clock::now();
+        auto next = ack_aggregator_.flush_expired(now,
+            [this](std::string_view ack_id) {
+                send_ack(ack_id);
+        });
+
+        if (next != ack_aggregator::time_point::max())
+            setup_ack_timeout(next, now);
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+}
+
 void connection::nack(const packet& p,
     bool with_transaction_id, stomplay::fun_type fn)
 {
@@ -339,32 +1060,76 @@ void connection::send(stompconn::logon frame, stomplay::fun_type real_fn)
 {
     assert(real_fn);
 
+    check_connected();
+
+    // запрошенный heart-beat для согласования с ответом
+    heart_beat_cx_ = frame.heart_beat_cx();
+    heart_beat_cy_ = frame.heart_beat_cy();
+
+    // сохраняем для переподключения
+    if (reconnect_)
+        logon_ = frame.headers();
+
     stomplay_.on_logon([this, fn = std::move(real_fn)](packet p) {
         exec_logon(fn, std::move(p));
     });
 
-    setup_write_timeout(write_timeout_);
-
-    bytes_writed_ += frame.write(bev_);
+    write(frame);
 }
 
 void connection::send(stompconn::subscribe frame, stomplay::fun_type fn)
 {
     assert(fn);
 
-    // получаем обработчик подписки
-    stomplay_.add_subscribe(frame, std::move(fn));
+    check_connected();
 
-    setup_write_timeout(write_timeout_);
+    if (reconnect_)
+    {
+        // заголовки без id и receipt
+        // id добавляется при повторе, receipt не нужен
+        auto headers = frame.headers();
+        auto id = stomplay_.add_subscribe(frame,
+            [this, real_fn = std::move(fn)](packet p) {
+                if (!p)
+                    resubscribe_.erase(std::string(p.subscription_id()));
+                real_fn(std::move(p));
+        });
+        resubscribe_.emplace(std::move(id), std::move(headers));
+    }
+    else
+    {
+        // получаем обработчик подписки
+        stomplay_.add_subscribe(frame, std::move(fn));
+    }
 
-    bytes_writed_ += frame.write(bev_);
+    write(frame);
 }
 
 void connection::send(stompconn::send frame, stomplay::fun_type fn)
 {
     assert(fn);
 
-    stomplay_.add_handler(frame, std::move(fn));
+    // с повтором кадр дождется восстановления соединения
+    auto replay = reconnect_ && reconnect_->policy().replay;
+    if (!(replay && reconnecting_))
+        check_connected();
+
+    if (replay)
+    {
+        auto seq_id = ++replay_seq_id_;
+        replay_.emplace(seq_id, replay_type{frame.headers(),
+            frame.payload_str(), std::move(fn)});
+
+        // отправится после восстановления соединения
+        if (reconnecting_)
+            return;
+
+        stomplay_.add_handler(frame, [this, seq_id](packet p) {
+            exec_replay(seq_id, std::move(p));
+        });
+    }
+    else
+        stomplay_.add_handler(frame, std::move(fn));
 
     send(std::move(frame));
 }
@@ -373,10 +1138,11 @@ void connection::send(stompconn::send_temp frame, stomplay::fun_type fn)
 {
     assert(fn);
 
-    // получаем обработчик подписки
-    stomplay_.add_subscribe(frame, std::move(fn));
+    check_connected();
 
-    stomplay_.add_handler(frame, std::move(fn));
+    // обработчик подписки получает и квитанцию кадра
+    // второй receipt с пустым fn не нужен
+    stomplay_.add_subscribe(frame, std::move(fn));
 
     send(std::move(frame));
 }
@@ -385,6 +1151,8 @@ void connection::send(stompconn::ack frame, stomplay::fun_type fn)
 {
     assert(fn);
 
+    check_connected();
+
     stomplay_.add_handler(frame, std::move(fn));
 
     send(std::move(frame));
@@ -394,6 +1162,8 @@ void connection::send(stompconn::nack frame, stomplay::fun_type fn)
 {
     assert(fn);
 
+    check_connected();
+
     stomplay_.add_handler(frame, std::move(fn));
 
     send(std::move(frame));
@@ -403,6 +1173,8 @@ void connection::send(stompconn::begin frame, stomplay::fun_type fn)
 {
     assert(fn);
 
+    check_connected();
+
     stomplay_.add_handler(frame, std::move(fn));
 
     send(std::move(frame));
@@ -412,6 +1184,8 @@ void connection::send(stompconn::commit frame, stomplay::fun_type fn)
 {
     assert(fn);
 
+    check_connected();
+
     stomplay_.add_handler(frame, std::move(fn));
 
     send(std::move(frame));
@@ -421,6 +1195,8 @@ void connection::send(stompconn::abort frame, stomplay::fun_type fn)
 {
     assert(fn);
 
+    check_connected();
+
     stomplay_.add_handler(frame, std::move(fn));
 
     send(std::move(frame));
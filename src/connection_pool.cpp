@@ -0,0 +1,289 @@
+#include "stompconn/connection_pool.hpp"
+
+using namespace stompconn;
+
+static event_base* create_queue()
+{
+    auto queue = event_base_new();
+    if (!queue)
+        throw std::runtime_error("event_base_new");
+    return queue;
+}
+
+connection_pool::member_type::member_type(connection_pool& pool,
+    std::size_t index, event_base* queue)
+    : pool(pool)
+    , index(index)
+    , own_queue(queue ? nullptr : create_queue(), event_base_free)
+    , conn(queue ? queue : own_queue.get(),
+        [this](short what) {
+            this->pool.do_event(*this, what);
+        }, [this] {
+            this->pool.do_connect(*this);
+        })
+{   }
+
+void connection_pool::member_type::do_stop() noexcept
+{
+    conn.disconnect();
+    event_base_loopexit(conn.queue(), nullptr);
+}
+
+bool connection_pool::member_type::disconnected() const noexcept
+{
+    // участник с повтором подключается сам
+    return !(ready.load() || conn.connected() ||
+        conn.connecting() || conn.reconnecting());
+}
+
+void connection_pool::member_type::do_wake() noexcept
+{
+    try
+    {
+        if (disconnected())
+            pool.connect(*this);
+    }
+    catch (...)
+    {
+        pool.do_event(*this, BEV_EVENT_ERROR);
+    }
+}
+
+connection_pool::connection_pool(event_base* queue, std::size_t size)
+    : queue_(queue)
+{
+    assert(queue);
+    if (!size)
+        throw std::runtime_error("connection pool empty");
+
+    member_.reserve(size);
+    for (std::size_t i = 0; i < size; ++i)
+        member_.push_back(std::make_unique<member_type>(*this, i, queue));
+}
+
+connection_pool::connection_pool(std::size_t size, std::size_t post_size)
+{
+    if (!size)
+        throw std::runtime_error("connection pool empty");
+
+    member_.reserve(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        auto m = std::make_unique<member_type>(*this, i, nullptr);
+        m->conn.post_queue(post_size);
+        m->stop.create(m->conn.queue(), m->stop_fn);
+        m->wake.create(m->conn.queue(), m->wake_fn);
+        member_.push_back(std::move(m));
+    }
+}
+
+connection_pool::~connection_pool() noexcept
+{
+    disconnect();
+}
+
+void connection_pool::connect(const std::string& host, int port,
+    std::string_view login, std::string_view passcode, std::string_view vhost)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        host_ = host;
+        port_ = port;
+        vhost_ = vhost;
+        login_ = login;
+        passcode_ = passcode;
+    }
+
+    for (auto& m : member_)
+    {
+        if (!queue_ && m->thread.joinable())
+        {
+            // соединением владеет поток участника
+            if (!m->ready.load())
+                m->wake.send();
+            continue;
+        }
+
+        // подключаем только отключенных
+        if (!m->disconnected())
+            continue;
+
+        connect(*m);
+
+        if (!queue_)
+        {
+            auto queue = m->conn.queue();
+            m->thread = std::thread([queue]{
+                event_base_dispatch(queue);
+            });
+        }
+    }
+}
+
+void connection_pool::connect(member_type& m)
+{
+    std::string host;
+    int port;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        host = host_;
+        port = port_;
+    }
+
+    m.conn.connect(host, port);
+}
+
+void connection_pool::disconnect() noexcept
+{
+    for (auto& m : member_)
+    {
+        if (!queue_)
+        {
+            if (m->thread.joinable())
+            {
+                m->stop.send();
+                m->thread.join();
+            }
+        }
+        else
+            m->conn.disconnect();
+
+        m->ready.store(false);
+        lost_ += m->inflight;
+        m->inflight = 0;
+    }
+}
+
+void connection_pool::do_connect(member_type& m) noexcept
+{
+    try
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stompconn::logon frame(vhost_, login_, passcode_);
+        lock.unlock();
+
+        m.conn.send(std::move(frame),
+            [this, &m](packet p) {
+                do_logon(m, std::move(p));
+        });
+    }
+    catch (...)
+    {
+        m.conn.disconnect();
+        do_event(m, BEV_EVENT_ERROR);
+    }
+}
+
+void connection_pool::do_logon(member_type& m, packet p) noexcept
+{
+    if (!p)
+    {
+        m.conn.disconnect();
+        do_event(m, BEV_EVENT_ERROR);
+        return;
+    }
+
+    m.ready.store(true);
+
+    try
+    {
+        if (on_ready_fun_)
+            on_ready_fun_(m.index);
+    }
+    catch (...)
+    {   }
+}
+
+void connection_pool::do_event(member_type& m, short what) noexcept
+{
+    // следующие кадры уйдут другим участникам
+    m.ready.store(false);
+    if (queue_)
+    {
+        lost_ += m.inflight;
+        m.inflight = 0;
+    }
+
+    try
+    {
+        if (on_event_fun_)
+            on_event_fun_(m.index, what);
+    }
+    catch (...)
+    {   }
+}
+
+connection_pool::member_type*
+    connection_pool::select(std::size_t start) const noexcept
+{
+    auto size = member_.size();
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        auto& m = member_[(start + i) % size];
+        if (m->ready.load(std::memory_order_relaxed))
+            return m.get();
+    }
+    return nullptr;
+}
+
+connection_pool::member_type*
+    connection_pool::select(std::string_view key) const noexcept
+{
+    fnv1a h;
+    return select(static_cast<std::size_t>(h(key.data(), key.size())));
+}
+
+connection_pool::member_type* connection_pool::select() noexcept
+{
+    return select(next_.fetch_add(1, std::memory_order_relaxed));
+}
+
+bool connection_pool::send(member_type* m,
+    stompconn::send frame, stomplay::fun_type fn)
+{
+    assert(fn);
+
+    if (!queue_)
+        throw std::logic_error("connection pool receipt in thread mode");
+
+    if (!m)
+        return false;
+
+    m->conn.send(std::move(frame), [this, m, fn = std::move(fn)](packet p) {
+        exec_receipt(*m, fn, std::move(p));
+    });
+    ++m->inflight;
+
+    return true;
+}
+
+void connection_pool::exec_receipt(member_type& m,
+    const stomplay::fun_type& fn, packet p) noexcept
+{
+    if (m.inflight)
+        --m.inflight;
+    ++confirmed_;
+
+    try
+    {
+        fn(std::move(p));
+    }
+    catch (...)
+    {   }
+}
+
+std::size_t connection_pool::ready() const noexcept
+{
+    std::size_t rc = 0;
+    for (auto& m : member_)
+        rc += m->ready.load(std::memory_order_relaxed);
+    return rc;
+}
+
+std::size_t connection_pool::inflight() const noexcept
+{
+    std::size_t rc = 0;
+    for (auto& m : member_)
+        rc += m->inflight;
+    return rc;
+}
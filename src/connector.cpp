@@ -0,0 +1,275 @@
+#include "stompconn/connector.hpp"
+
+#include <cstring>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif // _WIN32
+
+using namespace stompconn;
+
+connector::connector(event_base* queue, evdns_base* dns,
+    std::chrono::milliseconds stagger, fn_type fn)
+    : connector(queue, dns, stagger, timeval{0, 0}, std::move(fn))
+{   }
+
+connector::connector(event_base* queue, evdns_base* dns,
+    std::chrono::milliseconds stagger, timeval timeout, fn_type fn)
+    : queue_(queue)
+    , dns_(dns)
+    , stagger_(stagger)
+    , timeout_(timeout)
+    , fn_(std::move(fn))
+{
+    assert(queue);
+    assert(fn_);
+}
+
+connector::~connector() noexcept
+{
+    cancel();
+}
+
+void connector::start(const std::vector<endpoint>& endpoints)
+{
+    if (endpoints.empty())
+        throw std::runtime_error("connector endpoints empty");
+
+    evutil_addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = EVUTIL_AI_ADDRCONFIG;
+
+    for (auto& e : endpoints)
+    {
+        auto port = std::to_string(e.port);
+        evutil_addrinfo* res = nullptr;
+
+        // числовой адрес не требует dns
+        if (dns_)
+        {
+            auto numeric = hints;
+            numeric.ai_flags |= EVUTIL_AI_NUMERICHOST;
+            if (0 == evutil_getaddrinfo(e.host.c_str(),
+                port.c_str(), &numeric, &res))
+            {
+                push(res);
+                evutil_freeaddrinfo(res);
+                continue;
+            }
+        }
+
+        if (dns_)
+        {
+            // семейство выбирает libevent
+            // с явным AF_INET6 без настроенного IPv6 он падает в 2.1
+            address_type a;
+            a.host = e.host;
+            a.port = e.port;
+            a.family = AF_UNSPEC;
+            v4_.push_back(std::move(a));
+        }
+        else
+        {
+            if (0 == evutil_getaddrinfo(e.host.c_str(),
+                port.c_str(), &hints, &res))
+            {
+                push(res);
+                evutil_freeaddrinfo(res);
+            }
+        }
+    }
+
+    if (!start_next())
+        check_failed();
+}
+
+void connector::push(const evutil_addrinfo* res)
+{
+    for (auto ai = res; ai; ai = ai->ai_next)
+    {
+        if (!ai->ai_addr ||
+            (static_cast<std::size_t>(ai->ai_addrlen) > sizeof(sockaddr_storage)))
+            continue;
+
+        address_type a;
+        std::memcpy(&a.addr, ai->ai_addr, ai->ai_addrlen);
+        a.len = static_cast<ev_socklen_t>(ai->ai_addrlen);
+        a.family = ai->ai_family;
+
+        if (ai->ai_family == AF_INET6)
+            v6_.push_back(std::move(a));
+        else
+            v4_.push_back(std::move(a));
+    }
+}
+
+bool connector::start_next()
+{
+    while (!v6_.empty() || !v4_.empty())
+    {
+        // чередуем семейства, начиная с IPv6
+        auto& from = (prefer_v4_ && !v4_.empty()) || v6_.empty() ? v4_ : v6_;
+        auto a = std::move(from.front());
+        from.pop_front();
+        prefer_v4_ = (&from == &v6_);
+
+        auto& attempt = attempt_.emplace_back();
+        attempt.self = this;
+        attempt.starting = true;
+        try
+        {
+            // таймер и при разрешении имени через dns
+            if (timeout_.tv_sec || timeout_.tv_usec)
+            {
+                attempt.timer.create(queue_, -1, EV_TIMEOUT,
+                    timeoutcb, &attempt);
+                attempt.timer.add(timeout_);
+            }
+
+            attempt.handle.create(queue_, -1);
+            attempt.handle.set(nullptr, nullptr, eventcb, &attempt);
+            // числовой адрес разрешается сразу
+            // и ошибка может прийти в eventcb до возврата
+            if (a.len)
+            {
+                attempt.handle.connect(
+                    reinterpret_cast<const sockaddr*>(&a.addr), a.len);
+            }
+            else
+                attempt.handle.connect(dns_, a.family, a.host, a.port);
+        }
+        catch (...)
+        {
+            attempt.what = BEV_EVENT_ERROR;
+        }
+        attempt.starting = false;
+
+        if (attempt.what)
+        {
+            auto what = attempt.what;
+            if (what & BEV_EVENT_CONNECTED)
+            {
+                exec_event(std::prev(attempt_.end()), what);
+                return true;
+            }
+
+            last_error_ = what;
+            attempt_.pop_back();
+            continue;
+        }
+
+        if (stagger_ev_.empty())
+            stagger_ev_.create(queue_, -1, EV_TIMEOUT, staggercb, this);
+        stagger_ev_.add(stagger_);
+
+        return true;
+    }
+
+    return false;
+}
+
+void connector::staggercb(evutil_socket_t, short, void* arg)
+{
+    assert(arg);
+    auto self = static_cast<connector*>(arg);
+    // после start_next connector может быть уже удален
+    try
+    {
+        self->start_next();
+    }
+    catch (...)
+    {   }
+}
+
+void connector::eventcb(bufferevent*, short what, void* arg)
+{
+    assert(arg);
+    auto a = static_cast<attempt_type*>(arg);
+    auto self = a->self;
+    auto it = self->find(a);
+    if (a->starting)
+    {
+        a->what = what;
+        return;
+    }
+
+    self->exec_event(it, what);
+}
+
+void connector::timeoutcb(evutil_socket_t, short, void* arg)
+{
+    assert(arg);
+    auto a = static_cast<attempt_type*>(arg);
+    auto self = a->self;
+    // попытка удаляется вместе с таймером, следующая стартует сразу
+    self->exec_event(self->find(a),
+        static_cast<short>(BEV_EVENT_TIMEOUT | BEV_EVENT_WRITING));
+}
+
+std::list<connector::attempt_type>::iterator
+    connector::find(attempt_type* a) noexcept
+{
+    auto it = attempt_.begin();
+    while ((it != attempt_.end()) && (&(*it) != a))
+        ++it;
+
+    assert(it != attempt_.end());
+    return it;
+}
+
+void connector::exec_event(std::list<attempt_type>::iterator it, short what)
+{
+    if (what & BEV_EVENT_CONNECTED)
+    {
+        auto winner = std::move(it->handle);
+        attempt_.erase(it);
+        winner.set(nullptr, nullptr, nullptr, nullptr);
+
+        cancel();
+
+        // fn может удалить connector
+        auto fn = std::move(fn_);
+        fn_ = nullptr;
+        fn(std::move(winner), what);
+        return;
+    }
+
+    last_error_ = what;
+    attempt_.erase(it);
+
+    bool started = false;
+    try
+    {
+        started = start_next();
+    }
+    catch (...)
+    {   }
+
+    if (!started)
+        check_failed();
+}
+
+void connector::check_failed()
+{
+    if (!fn_ || !attempt_.empty() || !v6_.empty() || !v4_.empty())
+        return;
+
+    cancel();
+
+    // fn может удалить connector
+    auto fn = std::move(fn_);
+    fn_ = nullptr;
+    fn(bev(), static_cast<short>(last_error_ | BEV_EVENT_ERROR));
+}
+
+void connector::cancel() noexcept
+{
+    stagger_ev_.destroy();
+    attempt_.clear();
+    v6_.clear();
+    v4_.clear();
+}
@@ -0,0 +1,314 @@
+#include "stompconn/dispatcher.hpp"
+
+using namespace stompconn;
+
+dispatcher::dispatcher(connection& conn,
+    std::size_t workers, std::size_t queue_size)
+    : conn_(conn)
+    , complete_(queue_size * 2)
+{
+    if (!workers)
+        throw std::runtime_error("dispatcher without workers");
+
+    notify_.create(conn.queue(), notify_fn_);
+
+    // чтение приостанавливается раньше чем заполнятся очереди
+    if (!conn.pending_limit())
+        conn.pending_limit(queue_size);
+
+    worker_.reserve(workers);
+    try
+    {
+        for (std::size_t i = 0; i < workers; ++i)
+        {
+            auto w = std::make_unique<worker_type>(queue_size);
+            auto ptr = w.get();
+            worker_.push_back(std::move(w));
+            ptr->thread = std::thread([this, ptr]{
+                run(*ptr);
+            });
+        }
+    }
+    catch (...)
+    {
+        stop();
+        throw;
+    }
+}
+
+dispatcher::~dispatcher() noexcept
+{
+    stop();
+}
+
+stomplay::fun_type dispatcher::handler(fn_type fn)
+{
+    assert(fn);
+    auto& ref = handler_.emplace_back(std::move(fn));
+    return [this, &ref](packet p) {
+        post(ref, 0, std::move(p));
+    };
+}
+
+stomplay::fun_type dispatcher::handler(std::string_view key, fn_type fn)
+{
+    assert(fn);
+    fnv1a h;
+    auto key_hash = h(key.data(), key.size());
+    auto& ref = handler_.emplace_back(std::move(fn));
+    return [this, &ref, key_hash](packet p) {
+        post(ref, key_hash, std::move(p));
+    };
+}
+
+void dispatcher::post(const fn_type& fn, fnv1a::type key, packet p)
+{
+    if (!running_.load(std::memory_order_relaxed))
+        return;
+
+    auto subscription_id = p.get_subscription();
+
+    std::string_view val;
+    if (key)
+        val = p.get(key);
+    if (val.empty())
+        val = subscription_id;
+
+    fnv1a h;
+    auto& w = *worker_[h(val.data(), val.size()) % worker_.size()];
+
+    auto f = order_.find(subscription_id);
+    if (f == order_.end())
+        f = order_.emplace(std::string(subscription_id), order_type()).first;
+    auto& order = std::get<1>(*f);
+    auto seq = order.base + order.window.size();
+    order.window.emplace_back();
+
+    conn_.hold(subscription_id);
+    item_type item{ &fn, result::done, seq, p.detach() };
+    ++inflight_;
+
+    push(w, item);
+}
+
+void dispatcher::push(worker_type& w, item_type& item)
+{
+    // очередь потока заполнена
+    // кадр ждет в backlog, поток очереди не блокируется
+    // рост ограничен паузой чтения по pending_limit
+    if (!w.backlog.empty() || !w.queue.push(item))
+    {
+        w.backlog.push_back(std::move(item));
+        return;
+    }
+
+    wakeup(w);
+}
+
+void dispatcher::drain_backlog()
+{
+    for (auto& w : worker_)
+    {
+        auto& backlog = w->backlog;
+        if (backlog.empty())
+            continue;
+
+        while (!backlog.empty() && w->queue.push(backlog.front()))
+            backlog.pop_front();
+
+        wakeup(*w);
+    }
+}
+
+void dispatcher::wakeup(worker_type& w)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (w.sleeping.load())
+    {
+        std::lock_guard<std::mutex> l(w.mutex);
+        w.cv.notify_one();
+    }
+}
+
+void dispatcher::run(worker_type& w) noexcept
+{
+    item_type item;
+    while (running_.load())
+    {
+        if (w.queue.pop(item))
+        {
+            exec(w, item);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> l(w.mutex);
+        w.sleeping.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (w.queue.empty() && running_.load())
+            w.cv.wait_for(l, std::chrono::milliseconds(100));
+        w.sleeping.store(false);
+    }
+}
+
+void dispatcher::exec(worker_type& w, item_type& item) noexcept
+{
+    assert(item.fn);
+    try
+    {
+        item.rc = (*item.fn)(item.packet);
+    }
+    catch (...)
+    {
+        item.rc = result::done;
+    }
+
+    // поток очереди сам разбирает complete_ пока ждет места
+    while (!complete_.push(item))
+    {
+        // поток очереди в stop ждет завершения и complete_ не разбирает
+        if (!running_.load())
+        {
+            w.rejected.push_back(std::move(item));
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    notify_.send();
+}
+
+void dispatcher::do_complete() noexcept
+{
+    item_type item;
+    while (complete_.pop(item))
+        complete(item);
+
+    drain_backlog();
+}
+
+void dispatcher::complete(item_type& item) noexcept
+{
+    assert(inflight_);
+    --inflight_;
+
+    auto& p = item.packet;
+    auto f = order_.find(p.get_subscription());
+    if (f != order_.end())
+    {
+        auto& order = std::get<1>(*f);
+        assert(item.seq >= order.base);
+        auto& done = order.window[item.seq - order.base];
+        done.ready = true;
+        done.rc = item.rc;
+
+        if (item.seq == order.base)
+        {
+            // первый в окне отправляем без копирования id
+            send_result(item.rc, p.get_id());
+            order.window.pop_front();
+            ++order.base;
+
+            // за ним могли ждать уже обработанные
+            while (!order.window.empty() && order.window.front().ready)
+            {
+                auto& front = order.window.front();
+                send_result(front.rc, front.id);
+                order.window.pop_front();
+                ++order.base;
+            }
+
+            if (order.window.empty())
+                order_.erase(f);
+        }
+        else if (item.rc != result::done)
+        {
+            try
+            {
+                done.id = p.get_id();
+            }
+            catch (...)
+            {
+                done.rc = result::done;
+            }
+        }
+    }
+
+    try
+    {
+        conn_.release(p.get_subscription());
+    }
+    catch (...)
+    {   }
+}
+
+void dispatcher::discard(item_type& item) noexcept
+{
+    assert(inflight_);
+    --inflight_;
+
+    try
+    {
+        conn_.release(item.packet.get_subscription());
+    }
+    catch (...)
+    {   }
+}
+
+void dispatcher::send_result(result rc, std::string_view id) noexcept
+{
+    try
+    {
+        switch (rc)
+        {
+        case result::ack:
+            conn_.send(stompconn::ack(id));
+            break;
+        case result::nack:
+            conn_.send(stompconn::nack(id));
+            break;
+        default:;
+        }
+    }
+    catch (...)
+    {   }
+}
+
+void dispatcher::stop() noexcept
+{
+    running_.store(false);
+
+    for (auto& w : worker_)
+    {
+        {
+            std::lock_guard<std::mutex> l(w->mutex);
+            w->cv.notify_one();
+        }
+
+        if (w->thread.joinable())
+            w->thread.join();
+    }
+
+    // потоки завершены, очереди разбираем здесь
+    // ack накопительный при ack:client, поэтому ничего не подтверждаем
+    // ни обработанные, ни ждущие за необработанными
+    item_type item;
+    while (complete_.pop(item))
+        discard(item);
+
+    for (auto& w : worker_)
+    {
+        for (auto& i : w->rejected)
+            discard(i);
+        w->rejected.clear();
+
+        while (w->queue.pop(item))
+            discard(item);
+
+        for (auto& i : w->backlog)
+            discard(i);
+        w->backlog.clear();
+    }
+
+    order_.clear();
+    notify_.destroy();
+}
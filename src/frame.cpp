@@ -3,6 +3,15 @@
 #include <stdexcept>
 #include <iostream>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 using namespace stompconn;
 using namespace std::literals;
 
@@ -13,29 +22,102 @@ using namespace std::literals;
 \\ (octet 92 and 92) translates to \ (octet 92)
 */
 
-static inline void push_encoded(buffer& buf, std::string_view str)
+// символы которые нужно экранировать
+static inline bool need_encode(char c) noexcept
+{
+    return (c == '\n') || (c == '\r') || (c == ':') || (c == '\\');
+}
+
+static inline std::string_view encode(char c) noexcept
+{
+    switch (c)
+    {
+    case '\n':
+        return "\\n"sv;
+    case '\r':
+        return "\\r"sv;
+    case ':':
+        return "\\c"sv;
+    }
+    return "\\\\"sv;
+}
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(__AVX2__)
+static inline unsigned first_bit(unsigned mask) noexcept
 {
-    for (auto c : str)
+#ifdef _MSC_VER
+    unsigned long rc;
+    _BitScanForward(&rc, mask);
+    return static_cast<unsigned>(rc);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+#endif
+
+// первый символ требующий экранирования или end
+static inline const char* find_encoded(const char* ptr, const char* end) noexcept
+{
+#ifdef __AVX2__
     {
-        switch (c)
+        const auto n = _mm256_set1_epi8('\n');
+        const auto r = _mm256_set1_epi8('\r');
+        const auto c = _mm256_set1_epi8(':');
+        const auto b = _mm256_set1_epi8('\\');
+        while (end - ptr >= 32)
         {
-        case '\n':
-            buf.append("\\n"sv);
-            break;
-        case '\r':
-            buf.append("\\r"sv);
-            break;
-        case ':':
-            buf.append("\\c"sv);
-            break;
-        case '\\':
-            buf.append("\\\\"sv);
-            break;
-        default:
-            buf.append(&c, 1);
-            break;
+            auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+            auto m = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, n), _mm256_cmpeq_epi8(v, r)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, c), _mm256_cmpeq_epi8(v, b)));
+            auto mask = static_cast<unsigned>(_mm256_movemask_epi8(m));
+            if (mask)
+                return ptr + first_bit(mask);
+            ptr += 32;
         }
     }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+    {
+        const auto n = _mm_set1_epi8('\n');
+        const auto r = _mm_set1_epi8('\r');
+        const auto c = _mm_set1_epi8(':');
+        const auto b = _mm_set1_epi8('\\');
+        while (end - ptr >= 16)
+        {
+            auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+            auto m = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, n), _mm_cmpeq_epi8(v, r)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, c), _mm_cmpeq_epi8(v, b)));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(m));
+            if (mask)
+                return ptr + first_bit(mask);
+            ptr += 16;
+        }
+    }
+#endif
+    while ((ptr < end) && !need_encode(*ptr))
+        ++ptr;
+    return ptr;
+}
+
+// чистые участки добавляются одним вызовом
+static inline void push_encoded(buffer& buf, std::string_view str)
+{
+    auto ptr = str.data();
+    auto end = ptr + str.size();
+    while (ptr < end)
+    {
+        auto f = find_encoded(ptr, end);
+        if (f != ptr)
+            buf.append(ptr, static_cast<std::size_t>(f - ptr));
+
+        if (f == end)
+            break;
+
+        buf.append(encode(*f));
+        ptr = f + 1;
+    }
 }
 
 void frame::push_header(std::string_view key, std::string_view value)
@@ -73,6 +155,19 @@ void frame::push_header_val(std::string_view prepared_key,
     push_encoded(data_, value);
 }
 
+// key ref, val safe
+void frame::push_header_safe(std::string_view prepared_key,
+                             std::string_view value)
+{
+    assert(!prepared_key.empty());
+
+    if (value.empty())
+        throw std::logic_error("frame header value empty");
+
+    data_.append(prepared_key);
+    data_.append(value);
+}
+
 void frame::push_method(std::string_view method)
 {
     if (method.empty())
@@ -113,11 +208,28 @@ buffer frame::data()
     return buffer(std::move(data_));
 }
 
+std::string frame::headers() const
+{
+    return data_.str();
+}
+
+evbuffer* frame::release()
+{
+    complete();
+
+    return data_.release();
+}
+
 std::string frame::str() const
 {
     return data_.str();
 }
 
+std::size_t frame::size() const noexcept
+{
+    return data_.size();
+}
+
 logon::logon(std::string_view host,
     std::string_view login, std::string_view passcode)
 {
@@ -142,6 +254,13 @@ logon::logon(std::string_view host)
     : logon(host, std::string_view(), std::string_view())
 {   }
 
+void logon::heart_beat(std::size_t cx, std::size_t cy)
+{
+    heart_beat_cx_ = cx;
+    heart_beat_cy_ = cy;
+    push(header::heart_beat(cx, cy));
+}
+
 subscribe::subscribe(std::string_view destination, fn_type fn)
     : fn_(std::move(fn))
 {
@@ -152,6 +271,16 @@ subscribe::subscribe(std::string_view destination, fn_type fn)
     push(header::destination(destination));
 }
 
+subscribe::subscribe(std::string_view destination,
+    fn_type fn, body_fn_type body_fn)
+    : subscribe(destination, std::move(fn))
+{
+    if (!body_fn)
+        throw std::runtime_error("body handler empty");
+
+    body_fn_ = std::move(body_fn);
+}
+
 std::string subscribe::add_subscribe(subscription_handler& handler)
 {
     auto subs_id = handler.create(std::move(fn_));
@@ -196,6 +325,29 @@ void body_frame::push_payload(const char *data, std::size_t size)
     payload_.append(data, size);
 }
 
+void body_frame::push_payload_ref(const char *data, std::size_t size,
+    evbuffer_ref_cleanup_cb cleanupfn, void *cleanupfn_arg)
+{
+    // цепочка со ссылкой переносится в буфер bev без копирования
+    payload_.append_ref(data, size, cleanupfn, cleanupfn_arg);
+}
+
+void body_frame::push_file(int fd, std::size_t offset, std::size_t length)
+{
+    if (fd == -1)
+        throw std::logic_error("file descriptor invalid");
+
+    if (!length)
+        throw std::logic_error("file segment empty");
+
+    payload_.append_file(fd, offset, length);
+}
+
+std::string body_frame::payload_str() const
+{
+    return payload_.str();
+}
+
 void body_frame::complete()
 {
     auto size = payload_.size();
@@ -240,6 +392,22 @@ std::string body_frame::str() const
     return rc;
 }
 
+std::size_t body_frame::size() const noexcept
+{
+    return data_.size() + payload_.size();
+}
+
+replay_frame::replay_frame(std::string_view headers, std::string_view payload)
+{
+    if (headers.empty())
+        throw std::runtime_error("replay headers empty");
+
+    data_.append(headers);
+
+    if (!payload.empty())
+        push_payload(payload.data(), payload.size());
+}
+
 send::send(std::string_view destination)
 {
     if (destination.empty())
@@ -249,6 +417,23 @@ send::send(std::string_view destination)
     push(header::destination(destination));
 }
 
+send::send(const frame_template& tmpl)
+{
+    auto prefix = tmpl.prefix();
+    data_.append(prefix.data(), prefix.size());
+}
+
+frame_template::frame_template(std::string_view destination)
+{
+    if (destination.empty())
+        throw std::runtime_error("destination empty");
+
+    frame f;
+    f.push(method::send());
+    f.push(header::destination(destination));
+    prefix_ = f.headers();
+}
+
 ack::ack(std::string_view ack_id)
 {
     if (ack_id.empty())
@@ -3,11 +3,49 @@
 
 using namespace stompconn;
 
-void receipt_handler::exec(iterator i, packet p) noexcept
+// номер квитанции печатается как hex без ведущих нулей
+static inline auto to_receipt_id(std::size_t id) noexcept
+{
+    constexpr static char digit[] = "0123456789abcdef";
+
+    char buf[sizeof(std::size_t) * 2];
+    auto ptr = buf + sizeof(buf);
+    do {
+        *--ptr = digit[id & 0xf];
+        id >>= 4;
+    } while (id);
+
+    return receipt_handler::hex_text_type(ptr,
+        static_cast<std::size_t>(buf + sizeof(buf) - ptr));
+}
+
+// разбираем номер квитанции обратно
+static inline bool from_receipt_id(std::string_view text,
+    std::size_t& id) noexcept
+{
+    if (text.empty() || (text.size() > sizeof(std::size_t) * 2))
+        return false;
+
+    std::size_t rc = 0;
+    for (auto c : text)
+    {
+        rc <<= 4;
+        if ((c >= '0') && (c <= '9'))
+            rc |= static_cast<std::size_t>(c - '0');
+        else if ((c >= 'a') && (c <= 'f'))
+            rc |= static_cast<std::size_t>(c - 'a' + 10);
+        else
+            return false;
+    }
+
+    id = rc;
+    return true;
+}
+
+void receipt_handler::exec(fn_type& fn, packet&& p) noexcept
 {
     try
     {
-        auto& fn = std::get<1>(*i);
         assert(fn);
         fn(std::move(p));
     }
@@ -15,44 +53,111 @@ void receipt_handler::exec(iterator i, packet p) noexcept
     {   }
 }
 
-std::string_view receipt_handler::create(fn_type fn)
+void receipt_handler::grow()
+{
+    auto capacity = receipt_.size() * 2;
+    auto mask = capacity - 1;
+
+    storage_type storage(capacity);
+    for (auto& slot : receipt_)
+    {
+        if (slot.fn)
+            storage[slot.id & mask] = std::move(slot);
+    }
+
+    receipt_.swap(storage);
+}
+
+receipt_handler::hex_text_type receipt_handler::create(fn_type fn)
 {
-    hex_text_type hex_id;
-    to_hex_print(hex_id, ++receipt_seq_id_);
-    auto& i = receipt_.emplace_front(std::string_view{hex_id}, std::move(fn));
-    return sv(std::get<0>(i));
+    assert(fn);
+
+    if (receipt_.empty())
+        receipt_.resize(initial_capacity);
+    else if (size_ >= receipt_.size())
+        grow();
+
+    // слот может быть занят давно ожидающей квитанцией
+    // она переносится в overflow, кольцо не растет из-за одной квитанции
+    auto id = ++receipt_seq_id_;
+    auto& slot = receipt_[id & (receipt_.size() - 1)];
+    if (slot.fn)
+        overflow_.emplace(slot.id, std::move(slot.fn));
+
+    slot.id = id;
+    slot.fn = std::move(fn);
+    ++size_;
+
+    return to_receipt_id(id);
 }
 
-bool receipt_handler::call(std::string_view id, packet p) noexcept
+bool receipt_handler::call(std::string_view text_id, packet&& p) noexcept
 {
-    auto i = receipt_.begin();
-    auto e = receipt_.end();
-    while (i != e)
+    std::size_t id = 0;
+    if (receipt_.empty() || !from_receipt_id(text_id, id))
+        return false;
+
+    // освобождаем слот до вызова
+    // обработчик может создать новые квитанции
+    fn_type fn;
+    auto& slot = receipt_[id & (receipt_.size() - 1)];
+    if (slot.fn && (slot.id == id))
     {
-        auto& receipt_id = std::get<0>(*i);
-        if (receipt_id == id)
-        {
-            exec(i, std::move(p));
-            receipt_.erase(i);
-            return true;
-        }
-
-        ++i;
+        fn = std::move(slot.fn);
+        slot.fn = nullptr;
     }
+    else
+    {
+        auto f = overflow_.find(id);
+        if (f == overflow_.end())
+            return false;
 
-    return false;
+        fn = std::move(std::get<1>(*f));
+        overflow_.erase(f);
+    }
+    --size_;
+
+    exec(fn, std::move(p));
+
+    return true;
 }
 
 void receipt_handler::clear()
 {
-    receipt_.clear();
+    for (auto& slot : receipt_)
+        slot.fn = nullptr;
+    overflow_.clear();
+    size_ = 0;
 }
 
-void subscription_handler::exec(iterator i, packet p) noexcept
+// идентификатор подписки созданный в create
+static inline bool from_subscription_id(std::string_view text,
+    std::size_t& id) noexcept
+{
+    // std::to_string от size_t не длиннее 20 символов
+    if (text.empty() || (text.size() > 19))
+        return false;
+
+    // to_string не дает ведущих нулей, "07" - другая подписка
+    if ((text.size() > 1) && (text.front() == '0'))
+        return false;
+
+    std::size_t rc = 0;
+    for (auto c : text)
+    {
+        if ((c < '0') || (c > '9'))
+            return false;
+        rc = rc * 10 + static_cast<std::size_t>(c - '0');
+    }
+
+    id = rc;
+    return true;
+}
+
+void subscription_handler::exec(fn_type& fn, packet&& p) noexcept
 {
     try
     {
-        auto& fn = std::get<1>(*i);
         assert(fn);
 
         fn(std::move(p));
@@ -61,6 +166,39 @@ void subscription_handler::exec(iterator i, packet p) noexcept
     {   }
 }
 
+void subscription_handler::grow()
+{
+    auto capacity = index_.size() * 2;
+    auto mask = capacity - 1;
+
+    index_type index(capacity);
+    for (auto& slot : index_)
+    {
+        if (slot.fn)
+            index[slot.id & mask] = slot;
+    }
+
+    index_.swap(index);
+}
+
+subscription_handler::fn_type*
+    subscription_handler::find(std::string_view text_id) noexcept
+{
+    std::size_t id = 0;
+    if (!index_.empty() && from_subscription_id(text_id, id))
+    {
+        auto& slot = index_[id & (index_.size() - 1)];
+        if (slot.fn && (slot.id == id))
+            return slot.fn;
+    }
+
+    auto f = subscription_.find(text_id);
+    if (f != subscription_.end())
+        return &std::get<1>(*f);
+
+    return nullptr;
+}
+
 void subscription_handler::create_subscription(const id_type& id, fn_type fn)
 {
     if (!fn)
@@ -73,30 +211,65 @@ void subscription_handler::create_subscription(const id_type& id, fn_type fn)
 
 subscription_handler::id_type subscription_handler::create(fn_type fn)
 {
-    auto id = std::to_string(++subscription_seq_id_);
-    create_subscription(id, std::move(fn));
+    if (!fn)
+        throw std::runtime_error("handler empty");
+
+    if (index_.empty())
+        index_.resize(initial_capacity);
+
+    auto num_id = ++subscription_seq_id_;
+    auto id = std::to_string(num_id);
+    auto f = subscription_.try_emplace(id, std::move(fn));
+    if (!f.second)
+        throw std::runtime_error("subscription exist");
+
+    // индекс растет с числом подписок, а не с разбросом номеров
+    if (subscription_.size() > index_.size())
+        grow();
+
+    // слот занят давней подпиской, новая ищется в map
+    auto& slot = index_[num_id & (index_.size() - 1)];
+    if (!slot.fn)
+    {
+        slot.id = num_id;
+        slot.fn = &std::get<1>(*f.first);
+    }
+
     return id;
 }
 
-void subscription_handler::remove(const id_type& id) noexcept
+void subscription_handler::remove(std::string_view text_id) noexcept
 {
-    subscription_.erase(id);
+    auto f = subscription_.find(text_id);
+    if (f == subscription_.end())
+        return;
+
+    std::size_t id = 0;
+    if (!index_.empty() && from_subscription_id(text_id, id))
+    {
+        auto& slot = index_[id & (index_.size() - 1)];
+        if (slot.fn == &std::get<1>(*f))
+            slot = slot_type();
+    }
+
+    subscription_.erase(f);
 }
 
-bool subscription_handler::call(const id_type& id, packet p) noexcept
+bool subscription_handler::call(std::string_view id, packet&& p) noexcept
 {
-    auto f = subscription_.find(id);
-    if (f != subscription_.end())
+    auto fn = find(id);
+    if (fn)
     {
-        exec(f, std::move(p));
+        exec(*fn, std::move(p));
         return true;
     }
 
     return false;
 }
 
-
 void subscription_handler::clear()
 {
     subscription_.clear();
-}
\ No newline at end of file
+    for (auto& slot : index_)
+        slot = slot_type();
+}
@@ -1,4 +1,10 @@
 #include "stompconn/libevent.hpp"
+#include "stompconn/buffer_pool.hpp"
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/socket.h>
+#endif // _WIN32
 #ifdef EVENT__HAVE_OPENSSL
 #include "event2/bufferevent_ssl.h"
 #endif
@@ -7,7 +13,11 @@ using namespace stompconn;
 
 evbuffer* detail::mem_buffer::create()
 {
-    auto ptr = evbuffer_new();
+    auto ptr = buffer_pool::acquire();
+    if (ptr)
+        return ptr;
+
+    ptr = evbuffer_new();
     if (!ptr)
         throw std::runtime_error("evbuffer_new");
     return ptr;
@@ -15,7 +25,8 @@ evbuffer* detail::mem_buffer::create()
 
 void detail::mem_buffer::free(evbuffer* ptr) noexcept
 {
-    evbuffer_free(ptr);
+    if (ptr && !buffer_pool::release(ptr))
+        evbuffer_free(ptr);
 }
 
 bufferevent* bev::assert_handle() const noexcept
@@ -121,6 +132,11 @@ void bev::set_timeout(timeval *timeout_read, timeval *timeout_write)
     bufferevent_set_timeouts(assert_handle(), timeout_read, timeout_write);
 }
 
+void bev::set_watermark(short events, std::size_t lowmark, std::size_t highmark) noexcept
+{
+    bufferevent_setwatermark(assert_handle(), events, lowmark, highmark);
+}
+
 ev::ev(ev&& other) noexcept
 {
     std::swap(handle_, other.handle_);
@@ -172,6 +188,81 @@ void ev::add(timeval* tv)
         event_add(assert_handle(), tv));
 }
 
+notify::~notify() noexcept
+{
+    destroy();
+}
+
+void notify::create(event_base* queue, call_type fn, void* arg)
+{
+    assert(fn);
+    destroy();
+
+#ifdef _WIN32
+    constexpr auto family = AF_INET;
+#else
+    constexpr auto family = AF_UNIX;
+#endif // _WIN32
+    detail::check_result("evutil_socketpair",
+        evutil_socketpair(family, SOCK_STREAM, 0, fd_));
+
+    call_ = fn;
+    arg_ = arg;
+    try
+    {
+        detail::check_result("evutil_make_socket_nonblocking",
+            evutil_make_socket_nonblocking(fd_[0]));
+        detail::check_result("evutil_make_socket_nonblocking",
+            evutil_make_socket_nonblocking(fd_[1]));
+
+        ev_.create(queue, fd_[0], EV_READ|EV_PERSIST, readcb, this);
+        ev_.add();
+    }
+    catch (...)
+    {
+        destroy();
+        throw;
+    }
+}
+
+void notify::destroy() noexcept
+{
+    ev_.destroy();
+    for (auto& fd : fd_)
+    {
+        if (fd != -1)
+        {
+            evutil_closesocket(fd);
+            fd = -1;
+        }
+    }
+    signaled_.store(false);
+}
+
+void notify::readcb(evutil_socket_t fd, short, void* arg)
+{
+    assert(arg);
+    auto self = static_cast<notify*>(arg);
+
+    char buf[64];
+    while (recv(fd, buf, sizeof(buf), 0) > 0)
+        ;
+
+    // сбрасываем до вызова обработчика
+    // чтобы не потерять сигнал пришедший во время обработки
+    self->signaled_.store(false);
+    self->call_(self->arg_);
+}
+
+void notify::send() noexcept
+{
+    if (!signaled_.exchange(true))
+    {
+        char c = 0;
+        ::send(fd_[1], &c, 1, 0);
+    }
+}
+
 timeval stompconn::gettimeofday_cached(event_base* queue)
 {
     timeval tv = {};
@@ -0,0 +1,131 @@
+#include "stompconn/publisher.hpp"
+
+using namespace stompconn;
+
+publisher::publisher(connection& conn, std::size_t max_count,
+    std::size_t max_bytes, std::size_t max_queue)
+    : conn_(conn)
+    , max_count_(max_count)
+    , max_bytes_(max_bytes)
+    , max_queue_(max_queue)
+{
+    if (!max_count)
+        throw std::runtime_error("publisher window empty");
+}
+
+void publisher::publish(stompconn::send frame, fn_type real_fn)
+{
+    auto size = frame.size();
+
+    conn_.send(std::move(frame), [this, size, generation = generation_,
+        fn = std::move(real_fn)](packet p) {
+            exec_receipt(fn, size, generation, std::move(p));
+    });
+
+    ++inflight_;
+    inflight_bytes_ += size;
+}
+
+void publisher::exec_receipt(const fn_type& fn,
+    std::size_t size, std::size_t generation, packet p) noexcept
+{
+    // окно сброшено в clear, кадр уже не учитывается
+    bool current = (generation == generation_);
+    if (current)
+    {
+        assert(inflight_);
+        --inflight_;
+        inflight_bytes_ -= (std::min)(size, inflight_bytes_);
+    }
+
+    try
+    {
+        fn(std::move(p));
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+
+    if (!current)
+        return;
+
+    try
+    {
+        drain();
+
+        if (blocked_ && writable())
+        {
+            blocked_ = false;
+            if (on_writable_fn_)
+                on_writable_fn_();
+        }
+    }
+    catch (...)
+    {
+        exec_error(std::current_exception());
+    }
+}
+
+void publisher::exec_error(std::exception_ptr ex) noexcept
+{
+    try
+    {
+        if (on_error_fn_)
+            on_error_fn_(ex);
+    }
+    catch (...)
+    {   }
+}
+
+void publisher::drain()
+{
+    while (!queue_.empty() && window_open(queue_.front().first.size()))
+    {
+        // без соединения кадр остается в очереди
+        if (!conn_.can_send())
+            break;
+
+        auto& val = queue_.front();
+        try
+        {
+            publish(std::move(std::get<0>(val)), std::move(std::get<1>(val)));
+        }
+        catch (...)
+        {
+            // кадр и его обработчик уже переданы соединению
+            queue_.pop_front();
+            throw;
+        }
+        queue_.pop_front();
+    }
+}
+
+bool publisher::send(stompconn::send frame, fn_type fn)
+{
+    assert(fn);
+
+    if (queue_.empty() && window_open(frame.size()))
+    {
+        publish(std::move(frame), std::move(fn));
+        return true;
+    }
+
+    if (queue_.size() < max_queue_)
+    {
+        queue_.emplace_back(std::move(frame), std::move(fn));
+        return true;
+    }
+
+    blocked_ = true;
+    return false;
+}
+
+void publisher::clear() noexcept
+{
+    ++generation_;
+    inflight_ = 0;
+    inflight_bytes_ = 0;
+    queue_.clear();
+    blocked_ = false;
+}
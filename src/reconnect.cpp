@@ -0,0 +1,36 @@
+#include "stompconn/reconnect.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace stompconn;
+
+backoff::backoff(const reconnect_policy& policy)
+    : policy_(policy)
+    , rand_(std::random_device{}())
+{
+    if (policy.min_delay.count() <= 0)
+        throw std::runtime_error("reconnect min delay");
+
+    if (policy.max_delay < policy.min_delay)
+        throw std::runtime_error("reconnect max delay");
+
+    if (policy.multiplier < 1.0)
+        throw std::runtime_error("reconnect multiplier");
+}
+
+std::chrono::milliseconds backoff::next()
+{
+    double low = static_cast<double>(policy_.min_delay.count());
+    double high = static_cast<double>(policy_.max_delay.count());
+
+    // степень ограничиваем чтобы не уйти в бесконечность
+    auto n = static_cast<double>((std::min)(attempt_, std::size_t(64)));
+    auto limit = (std::min)(high, low * std::pow(policy_.multiplier, n));
+    ++attempt_;
+
+    std::uniform_real_distribution<double> dist(low, limit);
+    return std::chrono::milliseconds(
+        static_cast<std::chrono::milliseconds::rep>(dist(rand_)));
+}
@@ -120,7 +120,17 @@ void stomplay::on_body(stomptalk::parser_hook& hook,
         dump_ += '\n';
         dump_ += std::string(reinterpret_cast<const char*>(data), size);
 #endif
-        recv_.append(data, size);
+        if (!stream_checked_)
+            start_stream();
+
+        if (streaming_)
+        {
+            buffer chunk;
+            take_body(chunk, data, size);
+            exec_on_body(std::move(chunk), body_event::data);
+        }
+        else
+            take_body(recv_, data, size);
         return;
     }
     catch (const std::exception& e)
@@ -135,6 +145,89 @@ void stomplay::on_body(stomptalk::parser_hook& hook,
     hook.set(stomptalk_error_generic);
 }
 
+void stomplay::take_body(buffer& dst, const void* data, std::size_t size)
+{
+    if (input_.handle())
+    {
+        // тело лежит во входном буфере
+        // удаляем уже разобранное и переносим цепочки
+        auto ptr = static_cast<const char*>(data);
+        assert(ptr >= input_ptr_);
+        auto offset = static_cast<std::size_t>(ptr - input_ptr_);
+        assert(offset >= input_removed_);
+        offset -= input_removed_;
+        if (offset)
+            input_.drain(offset);
+        input_.remove_buffer(dst, size);
+        input_removed_ += offset + size;
+    }
+    else
+        dst.append(data, size);
+}
+
+void stomplay::start_stream() noexcept
+{
+    stream_checked_ = true;
+
+    if (stream_.empty() || (method_ != st_method_message))
+        return;
+
+    auto subs = header_store_.get(st_header_subscription);
+    auto f = stream_.find(subs);
+    if (f == stream_.end())
+        return;
+
+    try
+    {
+        streaming_ = std::get<1>(*f);
+    }
+    catch (...)
+    {
+        return;
+    }
+
+    // заголовки до тела
+    exec_on_message(subs);
+}
+
+void stomplay::exec_on_body(buffer chunk, body_event event) noexcept
+{
+    try
+    {
+        streaming_(std::move(chunk), event);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "stomplay body chunk: " << e.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cerr << "stomplay body chunk" << std::endl;
+    }
+}
+
+void stomplay::abort_stream() noexcept
+{
+    if (streaming_)
+    {
+        // обработчик может отписаться, копию не трогаем после вызова
+        auto fn = std::move(streaming_);
+        streaming_ = nullptr;
+        try
+        {
+            fn(buffer(), body_event::abort);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "stomplay body abort: " << e.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "stomplay body abort" << std::endl;
+        }
+    }
+}
+
 void stomplay::on_frame_end(stomptalk::parser_hook&, const char*) noexcept
 {
 #ifdef STOMPCONN_DEBUG
@@ -155,6 +248,17 @@ void stomplay::on_frame_end(stomptalk::parser_hook&, const char*) noexcept
     }
 
     case st_method_message: {
+        // кадр без тела тоже завершает поток
+        if (!stream_checked_)
+            start_stream();
+
+        if (streaming_)
+        {
+            exec_on_body(buffer(), body_event::end);
+            streaming_ = nullptr;
+            break;
+        }
+
         auto subs = header_store_.get(st_header_subscription);
         if (!subs.empty())
             exec_on_message(subs);
@@ -242,7 +346,7 @@ void stomplay::exec_on_message(std::string_view text_id) noexcept
     {
         if (!text_id.empty())
         {
-            subscription_.call(subscription_handler::id_type{text_id},
+            subscription_.call(text_id,
                 packet(header_store_, session_, method_, std::move(recv_)));
         }
     }
@@ -256,6 +360,23 @@ void stomplay::exec_on_message(std::string_view text_id) noexcept
     }
 }
 
+std::size_t stomplay::parse(buffer_ref input,
+    const char* ptr, std::size_t size)
+{
+    input_ = input;
+    input_ptr_ = ptr;
+    input_removed_ = 0;
+
+    auto rc = stomp_.run(hook_, ptr, size);
+
+    input_ = buffer_ref();
+    // удаляем то что пропарсили и не перенесли
+    if (rc > input_removed_)
+        input.drain(rc - input_removed_);
+
+    return rc;
+}
+
 void stomplay::clear()
 {
     method_ = st_method_none;
@@ -263,16 +384,28 @@ void stomplay::clear()
     current_header_.clear();
     header_store_.clear();
     recv_.reset(buffer());
+    // тело предыдущего кадра не завершилось
+    abort_stream();
+    stream_checked_ = false;
+}
+
+void stomplay::reset()
+{
+    session_.clear();
+    receipt_.clear();
+    clear();
 }
 
 void stomplay::logout()
 {
+    abort_stream();
     session_.clear();
     subscription_.clear();
+    stream_.clear();
     receipt_.clear();
 }
 
-std::string_view stomplay::add_receipt(frame &frame, fun_type fn)
+stomplay::text_type stomplay::add_receipt(frame &frame, fun_type fn)
 {
     auto receipt = receipt_.create(std::move(fn));
     frame.push(stompconn::header::receipt(receipt));
@@ -282,13 +415,20 @@ std::string_view stomplay::add_receipt(frame &frame, fun_type fn)
 std::string stomplay::add_subscribe(subscribe& frame, fun_type fn)
 {
     auto subscription_id = frame.add_subscribe(subscription_);
+    auto body_fn = frame.release_body_fn();
+    if (body_fn)
+        stream_.emplace(subscription_id, std::move(body_fn));
+
     add_receipt(frame, [this, subscription_id, fn](auto packet) {
         try
         {
             packet.set_subscription_id(subscription_id);
 
             if (!packet)
+            {
                 subscription_.remove(subscription_id);
+                stream_.erase(subscription_id);
+            }
 
             fn(std::move(packet));
         }
@@ -332,4 +472,8 @@ std::string stomplay::add_subscribe(send_temp& frame, fun_type fn)
 void stomplay::unsubscribe(const std::string& text_id)
 {
     subscription_.remove(text_id);
+
+    auto f = stream_.find(text_id);
+    if (f != stream_.end())
+        stream_.erase(f);
 }